@@ -1,5 +1,7 @@
 #!/usr/bin/python3
 
+import os
+import platform
 import sys
 
 from setuptools import setup, Extension
@@ -10,20 +12,36 @@ if sys.version_info[0] == 2:
 setup_dict = dict(
     name="cobs",
     version="1.2.2",
-    packages=[ 'cobs', 'cobs.cobs', 'cobs.cobsr', 'cobs._version', ],
+    packages=[ 'cobs', 'cobs.cobs', 'cobs.cobsr', 'cobs.rcobs', 'cobs.frameindex', 'cobs.framestream', 'cobs._version', ],
     package_dir={
         'cobs' : 'src/cobs',
     },
     ext_modules=[
-        Extension('cobs.cobs._cobs_ext', [ 'src/ext/_cobs_ext.c', ]),
-        Extension('cobs.cobsr._cobsr_ext', [ 'src/ext/_cobsr_ext.c', ]),
+        Extension('cobs.cobs._cobs_ext', [ 'src/ext/_cobs_ext.c', ], depends=[ 'src/ext/cobs_kernel.h', 'src/ext/cobs_py_helpers.h', ]),
+        Extension('cobs.cobsr._cobsr_ext', [ 'src/ext/_cobsr_ext.c', ], depends=[ 'src/ext/cobsr_kernel.h', 'src/ext/cobs_py_helpers.h', ]),
+        Extension('cobs.rcobs._rcobs_ext', [ 'src/ext/_rcobs_ext.c', ]),
+        Extension('cobs.frameindex._frameindex_ext', [ 'src/ext/_frameindex_ext.c', ]),
     ],
 )
 
+if os.name == 'posix':
+    # Uses read() and writev() on file descriptors
+    setup_dict['ext_modules'].append(
+        Extension('cobs.framestream._framestream_ext', [ 'src/ext/_framestream_ext.c', ],
+                  depends=[ 'src/ext/cobs_kernel.h', 'src/ext/cobsr_kernel.h', ]))
+
+if platform.python_implementation() == 'PyPy':
+    # On PyPy, the C kernels are also built as a cffi module, which avoids
+    # the cpyext overhead of calling the C API extensions.
+    setup_dict['setup_requires'] = [ 'cffi>=1.12', ]
+    setup_dict['cffi_modules'] = [ 'src/ext/_cffi_kernels_build.py:ffibuilder', ]
+
 try:
     setup(**setup_dict)
 except KeyboardInterrupt:
     raise
 except:
     del setup_dict['ext_modules']
+    setup_dict.pop('setup_requires', None)
+    setup_dict.pop('cffi_modules', None)
     setup(**setup_dict)
@@ -6,9 +6,12 @@ The following sub-modules are provided:
 
     * ``cobs.cobs`` which implements plain COBS.
     * ``cobs.cobsr`` which implements COBS/Reduced.
+    * ``cobs.rcobs`` which implements Reverse COBS (rCOBS).
+    * ``cobs.frameindex`` which indexes frames in large COBS framed data.
+    * ``cobs.framestream`` which reads and writes COBS frames on file descriptors.
 """
 
-__all__ = [ 'cobs', 'cobsr', ]
+__all__ = [ 'cobs', 'cobsr', 'rcobs', 'frameindex', 'framestream', ]
 
 #from . import cobs
 #from . import cobsr
@@ -4,6 +4,8 @@ Consistent Overhead Byte Stuffing (COBS)
 This version is for Python 3.x.
 """
 
+import operator as _operator
+
 
 class DecodeError(Exception):
     pass
@@ -20,7 +22,21 @@ def _get_buffer_view(in_bytes):
         pass
     return mv
 
-def encode(in_bytes):
+
+def _frame_args(headroom, tailroom, delimiter):
+    """Check the encode framing parameters, each of which may be None.
+    Returns (framed, headroom, tail_len): whether any was given, so the
+    output is a bytearray, the headroom, and the number of zero bytes to
+    add after the encoded data."""
+    framed = headroom is not None or tailroom is not None or delimiter is not None
+    headroom = 0 if headroom is None else _operator.index(headroom)
+    tailroom = 0 if tailroom is None else _operator.index(tailroom)
+    if headroom < 0 or tailroom < 0:
+        raise ValueError('headroom and tailroom must not be negative')
+    return framed, headroom, tailroom + (1 if delimiter else 0)
+
+
+def encode(in_bytes, threads=1, *, headroom=None, tailroom=None, delimiter=None):
     """Encode a string using Consistent Overhead Byte Stuffing (COBS).
     
     Input is any byte string. Output is also a byte string.
@@ -28,12 +44,25 @@ def encode(in_bytes):
     Encoding guarantees no zero bytes in the output. The output
     string will be expanded slightly, by a predictable amount.
     
-    An empty string is encoded to '\\x01'"""
+    An empty string is encoded to '\\x01'
+    
+    The threads parameter is accepted for compatibility with the
+    C extension, but this implementation always encodes serially.
+    
+    If any of headroom, tailroom or delimiter is given (not None),
+    the output is a bytearray, even if they are zero or false. It has
+    headroom zero bytes before the encoded data, then a zero byte
+    delimiter if delimiter is true, then tailroom zero bytes. Link
+    layer headers and trailers can then be filled in without copying
+    the encoded data again."""
+    if threads < 1:
+        raise ValueError('threads must be at least 1')
     if isinstance(in_bytes, str):
         raise TypeError('Unicode-objects must be encoded as bytes first')
+    framed, headroom, tail_len = _frame_args(headroom, tailroom, delimiter)
     in_bytes_mv = _get_buffer_view(in_bytes)
     final_zero = True
-    out_bytes = bytearray()
+    out_bytes = bytearray(headroom)
     idx = 0
     search_start_idx = 0
     for in_char in in_bytes_mv:
@@ -52,17 +81,70 @@ def encode(in_bytes):
     if idx != search_start_idx or final_zero:
         out_bytes.append(idx - search_start_idx + 1)
         out_bytes += in_bytes_mv[search_start_idx:idx]
+    if framed:
+        out_bytes += bytes(tail_len)
+        return out_bytes
     return bytes(out_bytes)
 
 
-def decode(in_bytes):
+def encode_iov(in_bytes):
+    """Encode a string using Consistent Overhead Byte Stuffing (COBS),
+    without copying the data.
+    
+    Input is any byte buffer. Output is a list of buffers, which
+    alternate between a byte string of one or more length codes, and
+    a memoryview slice of the input holding a run of non-zero data
+    bytes. So b''.join() of the buffers gives the same result as
+    encode(), and the list can be passed directly to os.writev() or
+    socket.sendmsg().
+    
+    Each zero byte in the input adds a buffer, so for data with many
+    zeros, encode() is faster."""
+    if isinstance(in_bytes, str):
+        raise TypeError('Unicode-objects must be encoded as bytes first')
+    in_bytes_mv = _get_buffer_view(in_bytes)
+    out_buffers = []
+    # Length codes for empty runs are gathered up, to go in one byte
+    # string with the next length code.
+    num_codes = 0
+    idx = 0
+    while True:
+        end = min(idx + 0xFE, len(in_bytes_mv))
+        run_end = idx
+        while run_end < end and in_bytes_mv[run_end] != 0:
+            run_end += 1
+        found_zero = run_end < end
+        is_final = not found_zero and run_end == len(in_bytes_mv)
+        run_len = run_end - idx
+        len_code = run_len + 1
+        num_codes += 1
+        if run_len > 0:
+            out_buffers.append(b'\x01' * (num_codes - 1) + bytes((len_code,)))
+            out_buffers.append(in_bytes_mv[idx:run_end])
+            num_codes = 0
+        idx = run_end
+        if found_zero:
+            idx += 1
+        elif is_final:
+            break
+    if num_codes > 0:
+        out_buffers.append(b'\x01' * (num_codes - 1) + bytes((len_code,)))
+    return out_buffers
+
+
+def decode(in_bytes, threads=1):
     """Decode a string using Consistent Overhead Byte Stuffing (COBS).
     
     Input should be a byte string that has been COBS encoded. Output
     is also a byte string.
     
     A cobs.DecodeError exception will be raised if the encoded data
-    is invalid."""
+    is invalid.
+    
+    The threads parameter is accepted for compatibility with the
+    C extension, but this implementation always decodes serially."""
+    if threads < 1:
+        raise ValueError('threads must be at least 1')
     if isinstance(in_bytes, str):
         raise TypeError('Unicode-objects are not supported; byte buffer objects only')
     in_bytes_mv = _get_buffer_view(in_bytes)
@@ -89,3 +171,45 @@ def decode(in_bytes):
             else:
                 break
     return bytes(out_bytes)
+
+
+def decode_segments(in_bytes):
+    """Decode a string using Consistent Overhead Byte Stuffing (COBS),
+    without copying the data.
+    
+    Input should be a byte buffer that has been COBS encoded. Output
+    is a list of segments. Each run of non-zero data bytes is a
+    memoryview slice of the input buffer. Each zero byte implied by
+    the encoding is the byte string b'\\x00'. So b''.join() of the
+    segments gives the same result as decode(), and the list can be
+    passed directly to socket.sendmsg() or os.writev().
+    
+    A cobs.DecodeError exception will be raised if the encoded data
+    is invalid."""
+    if isinstance(in_bytes, str):
+        raise TypeError('Unicode-objects are not supported; byte buffer objects only')
+    in_bytes_mv = _get_buffer_view(in_bytes)
+    segments = []
+    idx = 0
+
+    if len(in_bytes_mv) > 0:
+        while True:
+            length = in_bytes_mv[idx]
+            if length == 0:
+                raise DecodeError("zero byte found in input")
+            idx += 1
+            end = idx + length - 1
+            copy_mv = in_bytes_mv[idx:end]
+            if 0 in copy_mv:
+                raise DecodeError("zero byte found in input")
+            if end > len(in_bytes_mv):
+                raise DecodeError("not enough input bytes for length code")
+            if end > idx:
+                segments.append(copy_mv)
+            idx = end
+            if idx < len(in_bytes_mv):
+                if length < 0xFF:
+                    segments.append(b'\x00')
+            else:
+                break
+    return segments
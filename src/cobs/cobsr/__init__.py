@@ -5,16 +5,39 @@ Functions are provided for encoding and decoding according to
 the COBS/R method.
 
 A pure Python implementation and a C extension implementation
-are provided. If the C extension is not available for some reason,
-the pure Python version will be used.
+are provided. The same C code can also be built as a cffi module,
+which is much faster than the C extension on PyPy. The fastest
+available implementation for the running interpreter is used. If
+neither native implementation is available for some reason, the
+pure Python version will be used.
 """
 
-try:
-    from ._cobsr_ext import *
-    _using_extension = True
-except ImportError:
+import sys as _sys
+
+# Native backends, fastest first. On PyPy, C API extension calls go through
+# the slow cpyext layer, so the cffi backend is preferred there.
+if _sys.implementation.name == 'pypy':
+    _native_backends = ('cffi', 'ext')
+else:
+    _native_backends = ('ext', 'cffi')
+
+_backend = 'py'
+for _name in _native_backends:
+    try:
+        if _name == 'ext':
+            from ._cobsr_ext import *
+        else:
+            from ._cobsr_cffi import *
+    except ImportError:
+        continue
+    _backend = _name
+    break
+else:
     from ._cobsr_py import *
-    _using_extension = False
+del _name
+
+# _backend is 'ext' (C API extension), 'cffi' or 'py' (pure Python).
+_using_extension = (_backend != 'py')
 
 DecodeError.__module__ = 'cobs.cobsr'
 
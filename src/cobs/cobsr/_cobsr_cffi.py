@@ -0,0 +1,125 @@
+"""
+Consistent Overhead Byte Stuffing/Reduced (COBS/R)
+
+This version calls the C kernels through cffi, for PyPy.
+"""
+
+from .._cffi_kernels import ffi, lib
+from ._cobsr_py import DecodeError, _get_buffer_view, _frame_args
+# decode_segments() only follows the length codes and slices the input, so
+# there is no work for C to speed up.
+from ._cobsr_py import decode_segments
+
+
+__all__ = [ 'DecodeError', 'encode', 'decode', 'encode_iov', 'decode_segments', ]
+
+
+def encode(in_bytes, *, headroom=None, tailroom=None, delimiter=None):
+    """Encode a string using Consistent Overhead Byte Stuffing/Reduced (COBS/R).
+    
+    Input is any byte string. Output is also a byte string.
+    
+    Encoding guarantees no zero bytes in the output. The output
+    string may be expanded slightly, by a predictable amount.
+    
+    An empty string is encoded to '\\x01'
+    
+    If any of headroom, tailroom or delimiter is given (not None),
+    the output is a bytearray, even if they are zero or false. It has
+    headroom zero bytes before the encoded data, then a zero byte
+    delimiter if delimiter is true, then tailroom zero bytes. Link
+    layer headers and trailers can then be filled in without copying
+    the encoded data again."""
+    if isinstance(in_bytes, str):
+        raise TypeError('Unicode-objects must be encoded as bytes first')
+    framed, headroom, tail_len = _frame_args(headroom, tailroom, delimiter)
+    in_bytes_mv = _get_buffer_view(in_bytes)
+    src_len = len(in_bytes_mv)
+    max_len = src_len + src_len // 254 + 1
+    if framed:
+        # Encode straight into the output after the headroom, then trim
+        # the unused worst case space and add the tail. The view of the
+        # output is released first, as a bytearray with an export can't
+        # be resized (PyPy wouldn't free it promptly).
+        out_bytes = bytearray(headroom + max_len + tail_len)
+        with ffi.from_buffer(out_bytes) as dst_buf:
+            dst_len = lib.cobsr_encode_buf(ffi.from_buffer(in_bytes_mv), src_len, dst_buf + headroom)
+        del out_bytes[headroom + dst_len:]
+        out_bytes += bytes(tail_len)
+        return out_bytes
+    dst_buf = ffi.new('char[]', max_len)
+    dst_len = lib.cobsr_encode_buf(ffi.from_buffer(in_bytes_mv), src_len, dst_buf)
+    return ffi.buffer(dst_buf, dst_len)[:]
+
+
+def encode_iov(in_bytes):
+    """Encode a string using Consistent Overhead Byte Stuffing/Reduced (COBS/R),
+    without copying the data.
+    
+    Input is any byte buffer. Output is a list of buffers, which
+    alternate between a byte string of one or more length codes, and
+    a memoryview slice of the input holding a run of non-zero data
+    bytes. So b''.join() of the buffers gives the same result as
+    encode(), and the list can be passed directly to os.writev() or
+    socket.sendmsg().
+    
+    If the COBS/R encoding moves the final data byte into the final
+    length code, the final memoryview slice is one byte shorter.
+    
+    Each zero byte in the input adds a buffer, so for data with many
+    zeros, encode() is faster."""
+    if isinstance(in_bytes, str):
+        raise TypeError('Unicode-objects must be encoded as bytes first')
+    in_bytes_mv = _get_buffer_view(in_bytes)
+    out_buffers = []
+    # Length codes for empty runs are gathered up, to go in one byte
+    # string with the next length code.
+    src = ffi.from_buffer(in_bytes_mv)
+    num_codes = 0
+    idx = 0
+    while True:
+        end = min(idx + 0xFE, len(in_bytes_mv))
+        run_end = idx + lib.cobs_run_len(src + idx, end - idx)
+        found_zero = run_end < end
+        is_final = not found_zero and run_end == len(in_bytes_mv)
+        run_len = run_end - idx
+        len_code = run_len + 1
+        if is_final and run_len > 0 and in_bytes_mv[run_end - 1] >= len_code:
+            # Special COBS/R encoding: length code is final byte,
+            # and final byte is removed from data sequence.
+            len_code = in_bytes_mv[run_end - 1]
+            run_end -= 1
+            run_len -= 1
+        num_codes += 1
+        if run_len > 0:
+            out_buffers.append(b'\x01' * (num_codes - 1) + bytes((len_code,)))
+            out_buffers.append(in_bytes_mv[idx:run_end])
+            num_codes = 0
+        idx = run_end
+        if found_zero:
+            idx += 1
+        elif is_final:
+            break
+    if num_codes > 0:
+        out_buffers.append(b'\x01' * (num_codes - 1) + bytes((len_code,)))
+    return out_buffers
+
+
+def decode(in_bytes):
+    """Decode a string using Consistent Overhead Byte Stuffing/Reduced (COBS/R).
+    
+    Input should be a byte string that has been COBS/R encoded. Output
+    is also a byte string.
+    
+    A cobsr.DecodeError exception will be raised if the encoded data
+    is invalid. That is, if the encoded data contains zeros."""
+    if isinstance(in_bytes, str):
+        raise TypeError('Unicode-objects are not supported; byte buffer objects only')
+    in_bytes_mv = _get_buffer_view(in_bytes)
+    src_len = len(in_bytes_mv)
+    dst_buf = ffi.new('char[]', max(src_len, 1))
+    dst_len_ptr = ffi.new('size_t *')
+    status = lib.cobsr_decode_buf(ffi.from_buffer(in_bytes_mv), src_len, dst_buf, dst_len_ptr)
+    if status != lib.COBS_DECODE_OK:
+        raise DecodeError("zero byte found in input")
+    return ffi.buffer(dst_buf, dst_len_ptr[0])[:]
@@ -4,6 +4,8 @@ Consistent Overhead Byte Stuffing/Reduced (COBS/R)
 This version is for Python 3.x.
 """
 
+import operator as _operator
+
 
 class DecodeError(Exception):
     pass
@@ -20,7 +22,21 @@ def _get_buffer_view(in_bytes):
         pass
     return mv
 
-def encode(in_bytes):
+
+def _frame_args(headroom, tailroom, delimiter):
+    """Check the encode framing parameters, each of which may be None.
+    Returns (framed, headroom, tail_len): whether any was given, so the
+    output is a bytearray, the headroom, and the number of zero bytes to
+    add after the encoded data."""
+    framed = headroom is not None or tailroom is not None or delimiter is not None
+    headroom = 0 if headroom is None else _operator.index(headroom)
+    tailroom = 0 if tailroom is None else _operator.index(tailroom)
+    if headroom < 0 or tailroom < 0:
+        raise ValueError('headroom and tailroom must not be negative')
+    return framed, headroom, tailroom + (1 if delimiter else 0)
+
+
+def encode(in_bytes, *, headroom=None, tailroom=None, delimiter=None):
     """Encode a string using Consistent Overhead Byte Stuffing/Reduced (COBS/R).
     
     Input is any byte string. Output is also a byte string.
@@ -28,11 +44,19 @@ def encode(in_bytes):
     Encoding guarantees no zero bytes in the output. The output
     string may be expanded slightly, by a predictable amount.
     
-    An empty string is encoded to '\\x01'"""
+    An empty string is encoded to '\\x01'
+    
+    If any of headroom, tailroom or delimiter is given (not None),
+    the output is a bytearray, even if they are zero or false. It has
+    headroom zero bytes before the encoded data, then a zero byte
+    delimiter if delimiter is true, then tailroom zero bytes. Link
+    layer headers and trailers can then be filled in without copying
+    the encoded data again."""
     if isinstance(in_bytes, str):
         raise TypeError('Unicode-objects must be encoded as bytes first')
+    framed, headroom, tail_len = _frame_args(headroom, tailroom, delimiter)
     in_bytes_mv = _get_buffer_view(in_bytes)
-    out_bytes = bytearray()
+    out_bytes = bytearray(headroom)
     idx = 0
     search_start_idx = 0
     for in_char in in_bytes_mv:
@@ -59,9 +83,66 @@ def encode(in_bytes):
         # and final byte is removed from data sequence.
         out_bytes.append(final_byte_value)
         out_bytes += in_bytes_mv[search_start_idx:idx - 1]
+    if framed:
+        out_bytes += bytes(tail_len)
+        return out_bytes
     return bytes(out_bytes)
 
 
+def encode_iov(in_bytes):
+    """Encode a string using Consistent Overhead Byte Stuffing/Reduced (COBS/R),
+    without copying the data.
+    
+    Input is any byte buffer. Output is a list of buffers, which
+    alternate between a byte string of one or more length codes, and
+    a memoryview slice of the input holding a run of non-zero data
+    bytes. So b''.join() of the buffers gives the same result as
+    encode(), and the list can be passed directly to os.writev() or
+    socket.sendmsg().
+    
+    If the COBS/R encoding moves the final data byte into the final
+    length code, the final memoryview slice is one byte shorter.
+    
+    Each zero byte in the input adds a buffer, so for data with many
+    zeros, encode() is faster."""
+    if isinstance(in_bytes, str):
+        raise TypeError('Unicode-objects must be encoded as bytes first')
+    in_bytes_mv = _get_buffer_view(in_bytes)
+    out_buffers = []
+    # Length codes for empty runs are gathered up, to go in one byte
+    # string with the next length code.
+    num_codes = 0
+    idx = 0
+    while True:
+        end = min(idx + 0xFE, len(in_bytes_mv))
+        run_end = idx
+        while run_end < end and in_bytes_mv[run_end] != 0:
+            run_end += 1
+        found_zero = run_end < end
+        is_final = not found_zero and run_end == len(in_bytes_mv)
+        run_len = run_end - idx
+        len_code = run_len + 1
+        if is_final and run_len > 0 and in_bytes_mv[run_end - 1] >= len_code:
+            # Special COBS/R encoding: length code is final byte,
+            # and final byte is removed from data sequence.
+            len_code = in_bytes_mv[run_end - 1]
+            run_end -= 1
+            run_len -= 1
+        num_codes += 1
+        if run_len > 0:
+            out_buffers.append(b'\x01' * (num_codes - 1) + bytes((len_code,)))
+            out_buffers.append(in_bytes_mv[idx:run_end])
+            num_codes = 0
+        idx = run_end
+        if found_zero:
+            idx += 1
+        elif is_final:
+            break
+    if num_codes > 0:
+        out_buffers.append(b'\x01' * (num_codes - 1) + bytes((len_code,)))
+    return out_buffers
+
+
 def decode(in_bytes):
     """Decode a string using Consistent Overhead Byte Stuffing/Reduced (COBS/R).
     
@@ -97,3 +178,48 @@ def decode(in_bytes):
             else:
                 break
     return bytes(out_bytes)
+
+
+def decode_segments(in_bytes):
+    """Decode a string using Consistent Overhead Byte Stuffing/Reduced (COBS/R),
+    without copying the data.
+    
+    Input should be a byte buffer that has been COBS/R encoded. Output
+    is a list of segments. Each run of non-zero data bytes is a
+    memoryview slice of the input buffer. Each zero byte implied by
+    the encoding is the byte string b'\\x00'. If the final data byte
+    was moved into the final length code by the COBS/R encoding, it is
+    a one-byte memoryview slice of that length code. So b''.join() of
+    the segments gives the same result as decode(), and the list can be
+    passed directly to socket.sendmsg() or os.writev().
+    
+    A cobsr.DecodeError exception will be raised if the encoded data
+    is invalid. That is, if the encoded data contains zeros."""
+    if isinstance(in_bytes, str):
+        raise TypeError('Unicode-objects are not supported; byte buffer objects only')
+    in_bytes_mv = _get_buffer_view(in_bytes)
+    if 0 in in_bytes_mv:
+        raise DecodeError("zero byte found in input")
+    segments = []
+    idx = 0
+
+    while idx < len(in_bytes_mv):
+        code_idx = idx
+        length = in_bytes_mv[code_idx]
+        idx += 1
+        end = idx + length - 1
+        if end < len(in_bytes_mv):
+            if end > idx:
+                segments.append(in_bytes_mv[idx:end])
+            idx = end
+            if length < 0xFF:
+                segments.append(b'\x00')
+        else:
+            # Last length code. If it is greater than the number of bytes
+            # remaining, it is also the final data byte.
+            if len(in_bytes_mv) > idx:
+                segments.append(in_bytes_mv[idx:])
+            if end > len(in_bytes_mv):
+                segments.append(in_bytes_mv[code_idx:code_idx + 1])
+            break
+    return segments
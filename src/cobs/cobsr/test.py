@@ -7,6 +7,7 @@ This version is for Python 3.x.
 """
 
 from array import array
+import importlib
 import random
 import unittest
 
@@ -29,6 +30,17 @@ def non_zero_bytes(length):
     return b''.join(bytes([i]) for i in non_zero_generator(length))
 
 
+def available_backends():
+    """Return each implementation module that can be imported."""
+    backends = []
+    for name in ('_cobsr_py', '_cobsr_ext', '_cobsr_cffi'):
+        try:
+            backends.append(importlib.import_module('cobs.cobsr.' + name))
+        except ImportError:
+            pass
+    return backends
+
+
 class PredefinedEncodingsTests(unittest.TestCase):
     predefined_encodings = [
         [ b"",                                  b"\x01"                                                         ],
@@ -208,6 +220,14 @@ class InputTypesTest(unittest.TestCase):
             decoded = cobsr.decode(array_encoded_string)
             self.assertEqual(decoded, test_string)
 
+    def test_memoryview(self):
+        """Test that memoryview objects, including slices, can be encoded or decoded."""
+        for (test_string, expected_encoded_string) in self.predefined_encodings:
+            encoded = cobsr.encode(memoryview(b'_' + test_string + b'_')[1:-1])
+            self.assertEqual(encoded, expected_encoded_string)
+            decoded = cobsr.decode(memoryview(b'_' + expected_encoded_string + b'_')[1:-1])
+            self.assertEqual(decoded, test_string)
+
     def test_array_of_half_words(self):
         """Test that array of half-word objects (array('H', ...)) are not encoded or decoded.
         They should raise a BufferError."""
@@ -223,8 +243,191 @@ class InputTypesTest(unittest.TestCase):
                 cobsr.decode(array_encoded_string)
 
 
-class UtilTests(unittest.TestCase):
+class BackendTests(unittest.TestCase):
+    """Check each implementation that can be imported gives the same results."""
+
+    def test_backend_reported(self):
+        self.assertIn(cobsr._backend, ('ext', 'cffi', 'py'))
+        self.assertEqual(cobsr._using_extension, cobsr._backend != 'py')
+
+    def test_predefined_encodings(self):
+        for backend in available_backends():
+            for (test_string, expected_encoded_string) in PredefinedEncodingsTests.predefined_encodings:
+                self.assertEqual(backend.encode(test_string), expected_encoded_string, backend.__name__)
+                self.assertEqual(backend.decode(expected_encoded_string), test_string, backend.__name__)
+
+    def test_decode_error(self):
+        for backend in available_backends():
+            for test_encoded in PredefinedDecodeErrorTests.decode_error_test_strings:
+                with self.assertRaises(backend.DecodeError):
+                    backend.decode(test_encoded)
+
+    def test_random(self):
+        backends = available_backends()
+        for _test_num in range(500):
+            length = random.randint(0, 2000)
+            test_string = bytes(random.randint(0,255) for x in range(length))
+            encoded = cobsr.encode(test_string)
+            for backend in backends:
+                self.assertEqual(backend.encode(test_string), encoded, backend.__name__)
+                self.assertEqual(backend.decode(encoded), test_string, backend.__name__)
+
+
+class FramingTest(unittest.TestCase):
+    """Check encode() with headroom, tailroom and delimiter, in each
+    implementation that can be imported."""
+
+    def test_predefined_encodings(self):
+        for backend in available_backends():
+            for (test_string, encoded) in PredefinedEncodingsTests.predefined_encodings:
+                framed = backend.encode(test_string, headroom=2, tailroom=3, delimiter=True)
+                self.assertIsInstance(framed, bytearray)
+                self.assertEqual(framed, b"\x00\x00" + encoded + b"\x00" + b"\x00\x00\x00", backend.__name__)
+
+    def test_each_option(self):
+        test_string = b"12345\x006789"
+        encoded = cobsr.encode(test_string)
+        for backend in available_backends():
+            self.assertEqual(backend.encode(test_string, delimiter=True), encoded + b"\x00")
+            self.assertEqual(backend.encode(test_string, headroom=1), b"\x00" + encoded)
+            self.assertEqual(backend.encode(test_string, tailroom=4), encoded + b"\x00" * 4)
+            # Any framing keyword gives a bytearray, even if it is zero or
+            # false, so the output type doesn't depend on the values.
+            for kwargs in ({ 'headroom': 0 }, { 'tailroom': 0 }, { 'delimiter': False },
+                           { 'headroom': 0, 'tailroom': 0, 'delimiter': False }):
+                framed = backend.encode(test_string, **kwargs)
+                self.assertIsInstance(framed, bytearray, kwargs)
+                self.assertEqual(framed, encoded)
+            # Without framing keywords, or with them all None, the output is
+            # still a byte string.
+            for kwargs in ({}, { 'headroom': None, 'tailroom': None, 'delimiter': None }):
+                plain = backend.encode(test_string, **kwargs)
+                self.assertIsInstance(plain, bytes)
+                self.assertEqual(plain, encoded)
+
+    def test_fill_in_place(self):
+        for backend in available_backends():
+            framed = backend.encode(b"hello", headroom=2, delimiter=True)
+            framed[0:2] = b"\x07\x01"
+            self.assertEqual(bytes(framed), b"\x07\x01" + cobsr.encode(b"hello") + b"\x00")
+
+    def test_negative_room(self):
+        for backend in available_backends():
+            with self.assertRaises(ValueError):
+                backend.encode(b"12345", headroom=-1)
+            with self.assertRaises(ValueError):
+                backend.encode(b"12345", tailroom=-1)
+
+    def test_keyword_only(self):
+        for backend in available_backends():
+            with self.assertRaises(TypeError):
+                backend.encode(b"12345", 2, 3, True)
+
+
+class EncodeIovTest(unittest.TestCase):
+    """Check encode_iov() in each implementation that can be imported."""
+
+    def test_predefined_encodings(self):
+        for backend in available_backends():
+            for (test_string, encoded) in PredefinedEncodingsTests.predefined_encodings:
+                buffers = backend.encode_iov(test_string)
+                self.assertEqual(b''.join(buffers), encoded, backend.__name__)
+
+    def test_buffers(self):
+        for backend in available_backends():
+            test_string = bytearray(b"12345\x00\x00\x006789\x00")
+            buffers = backend.encode_iov(test_string)
+            self.assertEqual(buffers, [ b"\x06", b"12345", b"\x01\x01\x05", b"6789", b"\x01" ])
+            self.assertIsInstance(buffers[0], bytes)
+            self.assertIsInstance(buffers[1], memoryview)
+            # The data buffers are views of the input, not copies.
+            test_string[0] = ord("a")
+            self.assertEqual(buffers[1], b"a2345")
+
+    def test_final_byte_in_length_code(self):
+        for backend in available_backends():
+            buffers = backend.encode_iov(b"12345\x006789")
+            self.assertEqual(buffers, [ b"\x06", b"12345", b"9", b"678" ])
+            self.assertEqual(backend.encode_iov(b"\x7E"), [ b"\x7E" ])
+            self.assertEqual(backend.encode_iov(b"\x00\x7E"), [ b"\x01\x7E" ])
+
+    def test_input_types(self):
+        for backend in available_backends():
+            test_string = b"12345\x006789"
+            buffers = backend.encode_iov(array('b', test_string))
+            self.assertEqual(b''.join(buffers), cobsr.encode(test_string))
+            with self.assertRaises(TypeError):
+                backend.encode_iov(test_string.decode('latin-1'))
+
+    def test_random(self):
+        backends = available_backends()
+        for _test_num in range(200):
+            length = random.randint(0, 2000)
+            test_string = bytes(random.choice(b"\x00\x01\xff") if random.random() < 0.1
+                                else random.randint(1, 255) for x in range(length))
+            encoded = cobsr.encode(test_string)
+            for backend in backends:
+                buffers = backend.encode_iov(test_string)
+                self.assertEqual(b''.join(buffers), encoded, backend.__name__)
+                for i, buffer in enumerate(buffers):
+                    self.assertIsInstance(buffer, memoryview if i % 2 else bytes)
+                    self.assertTrue(len(buffer) > 0)
+
 
+class DecodeSegmentsTest(unittest.TestCase):
+    """Check decode_segments() in each implementation that can be imported."""
+
+    def test_predefined_encodings(self):
+        for backend in available_backends():
+            for (test_string, encoded) in PredefinedEncodingsTests.predefined_encodings:
+                segments = backend.decode_segments(encoded)
+                self.assertEqual(b''.join(segments), test_string, backend.__name__)
+
+    def test_segments(self):
+        for backend in available_backends():
+            encoded = bytearray(b"\x0612345\x01\x056789")
+            segments = backend.decode_segments(encoded)
+            self.assertEqual(segments, [ b"12345", b"\x00", b"\x00", b"6789" ])
+            self.assertIsInstance(segments[0], memoryview)
+            self.assertIsInstance(segments[1], bytes)
+            # The data segments are views of the input, not copies.
+            encoded[1] = ord("a")
+            self.assertEqual(segments[0], b"a2345")
+
+    def test_final_byte_in_length_code(self):
+        for backend in available_backends():
+            encoded = bytearray(b"\x06123459678")
+            segments = backend.decode_segments(encoded)
+            self.assertEqual(segments, [ b"12345", b"\x00", b"678", b"9" ])
+            self.assertIsInstance(segments[3], memoryview)
+            self.assertEqual(backend.decode_segments(b"\x7E"), [ b"\x7E" ])
+
+    def test_input_types(self):
+        for backend in available_backends():
+            encoded = cobsr.encode(b"12345\x006789")
+            segments = backend.decode_segments(array('b', encoded))
+            self.assertEqual(b''.join(segments), b"12345\x006789")
+            with self.assertRaises(TypeError):
+                backend.decode_segments(encoded.decode('latin-1'))
+
+    def test_decode_error(self):
+        for backend in available_backends():
+            for test_encoded in PredefinedDecodeErrorTests.decode_error_test_strings:
+                with self.assertRaises(backend.DecodeError):
+                    backend.decode_segments(test_encoded)
+
+    def test_random(self):
+        backends = available_backends()
+        for _test_num in range(200):
+            length = random.randint(0, 2000)
+            test_string = bytes(random.choice(b"\x00\x01\xff") if random.random() < 0.1
+                                else random.randint(1, 255) for x in range(length))
+            encoded = cobsr.encode(test_string)
+            for backend in backends:
+                self.assertEqual(b''.join(backend.decode_segments(encoded)), test_string, backend.__name__)
+
+
+class UtilTests(unittest.TestCase):
     def test_encoded_len_calc(self):
         self.assertEqual(cobsr.encoding_overhead(5), 1)
         self.assertEqual(cobsr.max_encoded_length(5), 6)
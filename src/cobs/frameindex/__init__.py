@@ -0,0 +1,220 @@
+"""
+Frame index for random access into COBS framed data.
+
+Large captures of COBS framed data (frames delimited by zero bytes)
+can be indexed once, by a fast scan for the zero byte delimiters.
+Then any frame, or the frames in a byte range, can be found and
+decoded on demand, without decoding from the start.
+
+A pure Python implementation and a C extension implementation
+of the delimiter scan are provided. If the C extension is not
+available for some reason, the pure Python version will be used.
+"""
+
+from array import array
+import bisect
+import mmap
+import os
+import struct
+import sys
+import zlib
+
+try:
+    from ._frameindex_ext import *
+    _using_extension = True
+except ImportError:
+    from ._frameindex_py import *
+    _using_extension = False
+
+from ._frameindex_py import _get_buffer_view
+from .. import cobs as _cobs
+
+from .._version import *
+
+
+__all__ = [ 'build_index', 'FrameIndex', 'scan_frames', ]
+
+
+# Index file format: header, then frame offsets, then frame lengths.
+# The header identifies the source data by its length, its modification
+# time (0 if it isn't a file) and a CRC-32 of its first and last blocks.
+# All values are little-endian.
+_INDEX_FILE_MAGIC = b'COBSIDX2'
+_INDEX_FILE_HEADER = struct.Struct('<8sQqIQ')
+_INDEX_FILE_CHECK_BLOCK_LEN = 64 * 1024
+
+
+def _is_path(source):
+    return isinstance(source, (str, os.PathLike))
+
+
+def _open_mapped(path):
+    """Open a file, and map it read-only into memory. Returns (file, mapping).
+    An empty file can't be mapped, so an empty byte string is used instead."""
+    f = open(path, 'rb')
+    try:
+        if os.fstat(f.fileno()).st_size == 0:
+            return f, b''
+        return f, mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    except:
+        f.close()
+        raise
+
+
+def _check_blocks_crc(data):
+    """CRC-32 of the first and last blocks of data, to detect a source that
+    has been rewritten since its index was saved."""
+    block_len = _INDEX_FILE_CHECK_BLOCK_LEN
+    crc = zlib.crc32(data[:block_len])
+    return zlib.crc32(data[max(block_len, len(data) - block_len):], crc)
+
+
+def build_index(buffer_or_path):
+    """Find the frames in COBS framed data.
+    
+    Input is either a byte buffer, or the path of a file, which is
+    memory-mapped rather than read. A frame is any non-empty run of
+    non-zero bytes; zero bytes are the frame delimiters.
+    
+    Returns a tuple (offsets, lengths) of array('q') objects, giving
+    the byte offset and length of each frame."""
+    if _is_path(buffer_or_path):
+        f, data = _open_mapped(buffer_or_path)
+        try:
+            return scan_frames(data)
+        finally:
+            if isinstance(data, mmap.mmap):
+                data.close()
+            f.close()
+    return scan_frames(buffer_or_path)
+
+
+class FrameIndex(object):
+    """Random access to the frames in COBS framed data.
+    
+    source is a byte buffer, or the path of a file, which is memory-mapped.
+    
+    codec is the module used to decode frames: cobs.cobs (the default) or
+    cobs.cobsr.
+    
+    If index_path is given, the index is loaded from that file if it exists
+    and matches the source data: its size, its modification time if it is a
+    file, and a checksum of its first and last blocks. Otherwise the index
+    is built, and saved to that file.
+    
+    Indexing with an integer decodes that frame. Indexing with a slice
+    returns a list of decoded frames."""
+
+    def __init__(self, source, codec=None, index_path=None):
+        self._file = None
+        self._mmap = None
+        self._data = None
+        self._mtime_ns = 0
+        self.codec = codec if codec is not None else _cobs
+        self.offsets = None
+        self.lengths = None
+        if _is_path(source):
+            self._file, source = _open_mapped(source)
+            if isinstance(source, mmap.mmap):
+                self._mmap = source
+        # Don't leave the file open if the index can't be loaded, built or
+        # saved.
+        try:
+            if self._file is not None:
+                self._mtime_ns = os.fstat(self._file.fileno()).st_mtime_ns
+            self._data = _get_buffer_view(source)
+
+            if index_path is not None and os.path.exists(index_path):
+                self._load(index_path)
+            if self.offsets is None:
+                self.offsets, self.lengths = build_index(source)
+                if index_path is not None:
+                    self.save(index_path)
+        except:
+            self.close()
+            raise
+
+    def __len__(self):
+        return len(self.offsets)
+
+    def __getitem__(self, key):
+        if isinstance(key, slice):
+            return [ self.decode_frame(i) for i in range(*key.indices(len(self))) ]
+        return self.decode_frame(key)
+
+    def __iter__(self):
+        for i in range(len(self)):
+            yield self.decode_frame(i)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info):
+        self.close()
+
+    def raw_frame(self, n):
+        """Return the encoded data of frame n, as a memoryview of the source."""
+        offset = self.offsets[n]
+        return self._data[offset:offset + self.lengths[n]]
+
+    def decode_frame(self, n):
+        """Decode frame n. Raises the codec's DecodeError if it is invalid."""
+        return self.codec.decode(self.raw_frame(n))
+
+    def frames_in_range(self, start, stop):
+        """Return a range of the numbers of the frames which start at byte
+        offsets from start up to (but not including) stop."""
+        return range(bisect.bisect_left(self.offsets, start),
+                     bisect.bisect_left(self.offsets, stop))
+
+    def save(self, index_path):
+        """Save the index to a file, to be loaded by a later FrameIndex."""
+        offsets = array('q', self.offsets)
+        lengths = array('q', self.lengths)
+        if sys.byteorder != 'little':
+            offsets.byteswap()
+            lengths.byteswap()
+        with open(index_path, 'wb') as f:
+            f.write(_INDEX_FILE_HEADER.pack(_INDEX_FILE_MAGIC, len(self._data), self._mtime_ns,
+                                            _check_blocks_crc(self._data), len(offsets)))
+            offsets.tofile(f)
+            lengths.tofile(f)
+
+    def _load(self, index_path):
+        with open(index_path, 'rb') as f:
+            header = f.read(_INDEX_FILE_HEADER.size)
+            if len(header) != _INDEX_FILE_HEADER.size:
+                return
+            magic, data_len, mtime_ns, crc, count = _INDEX_FILE_HEADER.unpack(header)
+            if (magic != _INDEX_FILE_MAGIC or data_len != len(self._data) or
+                    mtime_ns != self._mtime_ns or crc != _check_blocks_crc(self._data)):
+                return
+            # A truncated or corrupt file would give wrong or missing frames.
+            if os.fstat(f.fileno()).st_size != _INDEX_FILE_HEADER.size + 16 * count:
+                return
+            offsets = array('q')
+            lengths = array('q')
+            try:
+                offsets.fromfile(f, count)
+                lengths.fromfile(f, count)
+            except EOFError:
+                return
+        if sys.byteorder != 'little':
+            offsets.byteswap()
+            lengths.byteswap()
+        if count and offsets[-1] + lengths[-1] > len(self._data):
+            return
+        self.offsets = offsets
+        self.lengths = lengths
+
+    def close(self):
+        """Release the source data, and close the file if it was opened from
+        a path. Views returned by raw_frame() must be released first."""
+        if self._data is not None:
+            self._data.release()
+        if self._mmap is not None:
+            self._mmap.close()
+            self._mmap = None
+        if self._file is not None:
+            self._file.close()
+            self._file = None
@@ -0,0 +1,47 @@
+"""
+Consistent Overhead Byte Stuffing (COBS) frame index
+
+This version is for Python 3.x.
+"""
+
+from array import array
+
+
+def _get_buffer_view(in_bytes):
+    mv = memoryview(in_bytes)
+    if mv.ndim > 1 or mv.itemsize > 1:
+        raise BufferError('object must be a single-dimension buffer of bytes.')
+    try:
+        if mv.format != 'B':
+            mv = mv.cast('B')
+    except AttributeError:
+        pass
+    return mv
+
+def scan_frames(in_bytes):
+    """Find the frames in a buffer of COBS framed data.
+    
+    A frame is any non-empty run of non-zero bytes; zero bytes are
+    the frame delimiters.
+    
+    Returns a tuple (offsets, lengths) of array('q') objects, giving
+    the byte offset and length of each frame."""
+    if isinstance(in_bytes, str):
+        raise TypeError('Unicode-objects are not supported; byte buffer objects only')
+    in_bytes_mv = _get_buffer_view(in_bytes)
+    # bytes, bytearray and mmap have a fast find(); other buffers are copied.
+    if not hasattr(in_bytes, 'find') or in_bytes_mv.format != 'B':
+        in_bytes = in_bytes_mv.tobytes()
+    offsets = array('q')
+    lengths = array('q')
+    src_len = len(in_bytes_mv)
+    pos = 0
+    while pos < src_len:
+        end = in_bytes.find(b'\x00', pos)
+        if end < 0:
+            end = src_len
+        if end > pos:
+            offsets.append(pos)
+            lengths.append(end - pos)
+        pos = end + 1
+    return offsets, lengths
@@ -0,0 +1,211 @@
+"""
+Consistent Overhead Byte Stuffing (COBS) frame index
+
+Unit Tests
+
+This version is for Python 3.x.
+"""
+
+from array import array
+import os
+import random
+import shutil
+import struct
+import tempfile
+import unittest
+from unittest import mock
+
+from .. import cobs as cobs
+from .. import cobsr as cobsr
+from .. import frameindex as frameindex
+from ..frameindex import _frameindex_py as frameindex_py
+
+
+def random_messages(count, max_length=600, seed=1):
+    rng = random.Random(seed)
+    return [ bytes(rng.randint(0, 255) for x in range(rng.randint(0, max_length))) for i in range(count) ]
+
+def framed(codec, messages, leading_zero=False):
+    return (b'\x00' if leading_zero else b'') + b''.join(codec.encode(m) + b'\x00' for m in messages)
+
+
+class ScanFramesTests(unittest.TestCase):
+    predefined_scans = [
+        [ b"",                              [],                         [] ],
+        [ b"\x00",                          [],                         [] ],
+        [ b"\x00\x00\x00",                  [],                         [] ],
+        [ b"\x01",                          [ 0 ],                      [ 1 ] ],
+        [ b"\x01\x00",                      [ 0 ],                      [ 1 ] ],
+        [ b"\x0212\x00\x0634",              [ 0, 4 ],                   [ 3, 3 ] ],
+        [ b"\x00\x0212\x00\x00\x0634\x00",  [ 1, 6 ],                   [ 3, 3 ] ],
+    ]
+
+    def test_predefined_scans(self):
+        for scan_frames in (frameindex.scan_frames, frameindex_py.scan_frames):
+            for (data, expected_offsets, expected_lengths) in self.predefined_scans:
+                offsets, lengths = scan_frames(data)
+                self.assertEqual(offsets, array('q', expected_offsets))
+                self.assertEqual(lengths, array('q', expected_lengths))
+                self.assertEqual(frameindex.build_index(data), (offsets, lengths))
+
+    def test_random_scan_matches_python_implementation(self):
+        data = framed(cobs, random_messages(300), leading_zero=True)
+        self.assertEqual(frameindex.scan_frames(data), frameindex_py.scan_frames(data))
+        self.assertEqual(frameindex.scan_frames(bytearray(data)), frameindex_py.scan_frames(bytearray(data)))
+
+    def test_unicode_string(self):
+        with self.assertRaises(TypeError):
+            frameindex.scan_frames(u'\x01\x00')
+
+
+class FrameIndexTests(unittest.TestCase):
+    def setUp(self):
+        self.temp_dir = tempfile.mkdtemp()
+
+    def tearDown(self):
+        shutil.rmtree(self.temp_dir)
+
+    def write_file(self, name, data):
+        path = os.path.join(self.temp_dir, name)
+        with open(path, 'wb') as f:
+            f.write(data)
+        return path
+
+    def test_random_access(self):
+        messages = random_messages(500)
+        for codec in (cobs, cobsr):
+            index = frameindex.FrameIndex(framed(codec, messages), codec=codec)
+            self.assertEqual(len(index), len(messages))
+            for n in random.Random(2).sample(range(len(messages)), 50):
+                self.assertEqual(index[n], messages[n])
+            self.assertEqual(index[-1], messages[-1])
+            self.assertEqual(index[10:20], messages[10:20])
+            self.assertEqual(list(index), messages)
+
+    def test_raw_frame(self):
+        messages = random_messages(20)
+        index = frameindex.FrameIndex(framed(cobs, messages))
+        for n, message in enumerate(messages):
+            self.assertEqual(bytes(index.raw_frame(n)), cobs.encode(message))
+
+    def test_frames_in_range(self):
+        messages = random_messages(100)
+        data = framed(cobs, messages)
+        index = frameindex.FrameIndex(data)
+        start = len(data) // 3
+        stop = 2 * len(data) // 3
+        frames = index.frames_in_range(start, stop)
+        self.assertTrue(len(frames) > 0)
+        for n in frames:
+            self.assertTrue(start <= index.offsets[n] < stop)
+        self.assertTrue(index.offsets[frames[0] - 1] < start)
+        self.assertTrue(index.offsets[frames[-1] + 1] >= stop)
+
+    def test_file_source(self):
+        messages = random_messages(200)
+        path = self.write_file('capture.bin', framed(cobs, messages))
+        with frameindex.FrameIndex(path) as index:
+            self.assertEqual(len(index), len(messages))
+            self.assertEqual(index[123], messages[123])
+
+    def test_empty_file_source(self):
+        path = self.write_file('empty.bin', b'')
+        with frameindex.FrameIndex(path) as index:
+            self.assertEqual(len(index), 0)
+
+    def test_index_file(self):
+        messages = random_messages(200)
+        path = self.write_file('capture.bin', framed(cobs, messages))
+        index_path = os.path.join(self.temp_dir, 'capture.idx')
+        with frameindex.FrameIndex(path, index_path=index_path) as index:
+            offsets = list(index.offsets)
+        self.assertTrue(os.path.exists(index_path))
+
+        # The saved index is used for the unchanged file, rather than a new scan.
+        with mock.patch.object(frameindex, 'build_index') as build_index:
+            with frameindex.FrameIndex(path, index_path=index_path) as index:
+                self.assertEqual(list(index.offsets), offsets)
+            build_index.assert_not_called()
+
+    def test_index_file_rewritten_source(self):
+        messages = random_messages(200)
+        path = self.write_file('capture.bin', framed(cobs, messages))
+        index_path = os.path.join(self.temp_dir, 'capture.idx')
+        frameindex.FrameIndex(path, index_path=index_path).close()
+        stat = os.stat(path)
+
+        # Rewrite the capture file's contents without changing its size, nor
+        # (by restoring it) its modification time. The checksum catches it.
+        with open(path, 'r+b') as f:
+            # Replace the first delimiter, joining the first two frames.
+            f.seek(len(cobs.encode(messages[0])))
+            f.write(b'\x01')
+        os.utime(path, ns=(stat.st_atime_ns, stat.st_mtime_ns))
+        with frameindex.FrameIndex(path, index_path=index_path) as index:
+            self.assertEqual(len(index), len(messages) - 1)
+            self.assertEqual(index.offsets, frameindex.build_index(path)[0])
+
+        # Changing only the modification time also makes it rebuild.
+        os.utime(path, ns=(stat.st_atime_ns, stat.st_mtime_ns + 10**9))
+        with mock.patch.object(frameindex, 'build_index', wraps=frameindex.build_index) as build_index:
+            frameindex.FrameIndex(path, index_path=index_path).close()
+            build_index.assert_called_once()
+
+    def test_index_file_size_mismatch(self):
+        messages = random_messages(50)
+        index_path = os.path.join(self.temp_dir, 'capture.idx')
+        frameindex.FrameIndex(framed(cobs, messages), index_path=index_path)
+        index = frameindex.FrameIndex(framed(cobs, messages[:-1]), index_path=index_path)
+        self.assertEqual(len(index), len(messages) - 1)
+
+    def test_index_file_corrupt(self):
+        messages = random_messages(50)
+        data = framed(cobs, messages)
+        index_path = os.path.join(self.temp_dir, 'capture.idx')
+        frameindex.FrameIndex(data, index_path=index_path)
+        with open(index_path, 'rb') as f:
+            saved = f.read()
+
+        # Truncated, or with extra data after the arrays
+        for bad in (saved[:-8], saved + b'\x00' * 8):
+            with open(index_path, 'wb') as f:
+                f.write(bad)
+            index = frameindex.FrameIndex(data, index_path=index_path)
+            self.assertEqual(list(index), messages)
+
+        # Last frame runs past the end of the data
+        with open(index_path, 'wb') as f:
+            f.write(saved[:-8] + struct.pack('<q', len(data)))
+        index = frameindex.FrameIndex(data, index_path=index_path)
+        self.assertEqual(list(index), messages)
+        with open(index_path, 'rb') as f:
+            self.assertEqual(f.read(), saved)
+
+    def test_index_file_save_error_closes_source(self):
+        path = self.write_file('capture.bin', framed(cobs, random_messages(10)))
+        opened = []
+        def open_mapped(path):
+            opened.append(open_mapped.wrapped(path))
+            return opened[-1]
+        open_mapped.wrapped = frameindex._open_mapped
+        index_path = os.path.join(self.temp_dir, 'missing', 'capture.idx')
+        with mock.patch.object(frameindex, '_open_mapped', open_mapped):
+            with self.assertRaises(FileNotFoundError):
+                frameindex.FrameIndex(path, index_path=index_path)
+        f, mapping = opened[0]
+        self.assertTrue(f.closed)
+        self.assertTrue(mapping.closed)
+
+    def test_invalid_frame(self):
+        index = frameindex.FrameIndex(b'\x0612345\x00\x05123\x00')
+        self.assertEqual(index[0], b'12345')
+        with self.assertRaises(cobs.DecodeError):
+            index[1]
+
+
+def runtests():
+    unittest.main()
+
+
+if __name__ == '__main__':
+    runtests()
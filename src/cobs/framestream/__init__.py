@@ -0,0 +1,27 @@
+"""
+Reading and writing COBS frames on file descriptors.
+
+FrameReader reads zero-delimited COBS frames from a file descriptor,
+such as a pipe, socket, pty or serial port, and yields the decoded
+frames. FrameWriter encodes frames and writes them, batched, to a file
+descriptor.
+
+A pure Python implementation and a C extension implementation
+are provided. The C extension reads directly into a fixed buffer
+and decodes frames in place, and writes batches of frames with
+writev(), with the GIL released. It is only available on POSIX
+systems. If the C extension is not available for some reason, the
+pure Python version will be used.
+"""
+
+try:
+    from ._framestream_ext import *
+    _using_extension = True
+except ImportError:
+    from ._framestream_py import *
+    _using_extension = False
+
+from .._version import *
+
+
+__all__ = [ 'FrameReader', 'FrameWriter', ]
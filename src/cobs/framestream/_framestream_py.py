@@ -0,0 +1,163 @@
+"""
+Consistent Overhead Byte Stuffing (COBS) frame streams
+
+This version is for Python 3.x.
+"""
+
+import os
+
+from .. import cobs as _cobs
+
+
+_DEFAULT_BUFSIZE = 65536
+
+
+def _check_codec(codec):
+    if codec is None:
+        return _cobs
+    if getattr(codec, '__name__', None) not in ('cobs.cobs', 'cobs.cobsr'):
+        raise ValueError('codec must be the cobs.cobs or cobs.cobsr module')
+    return codec
+
+
+class FrameReader(object):
+    """Read and decode zero-delimited COBS frames from a file descriptor.
+
+    Iterating yields decoded frames until end of file.
+
+    A frame longer than bufsize is discarded, and the codec's DecodeError
+    is raised."""
+
+    def __init__(self, fd, bufsize=_DEFAULT_BUFSIZE, codec=None):
+        if bufsize < 1:
+            raise ValueError('bufsize must be at least 1')
+        self._codec = _check_codec(codec)
+        self._fd = fd
+        self._bufsize = bufsize
+        self._buf = bytearray()
+        self._scan = 0
+        self._discarding = False
+        self._eof = False
+
+    def read_frame(self):
+        """Return the next decoded frame, reading from the file descriptor
+        as needed. Returns None at end of file."""
+        while True:
+            end = self._buf.find(b'\x00', self._scan)
+            while end >= 0:
+                frame = self._buf[:end]
+                del self._buf[:end + 1]
+                self._scan = 0
+                if self._discarding:
+                    self._discarding = False
+                elif frame:
+                    return self._codec.decode(frame)
+                end = self._buf.find(b'\x00')
+            self._scan = len(self._buf)
+
+            if self._eof:
+                frame = self._buf
+                self._buf = bytearray()
+                self._scan = 0
+                discarding = self._discarding
+                self._discarding = False
+                if frame and not discarding:
+                    return self._codec.decode(frame)
+                return None
+
+            if self._discarding:
+                # All the buffered data is part of the frame that is too long
+                self._buf = bytearray()
+                self._scan = 0
+            elif len(self._buf) > self._bufsize:
+                # The byte read past bufsize isn't a delimiter either
+                self._buf = bytearray()
+                self._scan = 0
+                self._discarding = True
+                raise self._codec.DecodeError('frame too long for buffer')
+
+            # If a frame fills the buffer, read one more byte, to see if it
+            # is the delimiter.
+            data = os.read(self._fd, max(self._bufsize - len(self._buf), 1))
+            if not data:
+                self._eof = True
+            self._buf += data
+
+    def __iter__(self):
+        return self
+
+    def __next__(self):
+        frame = self.read_frame()
+        if frame is None:
+            raise StopIteration
+        return frame
+
+    def fileno(self):
+        """Return the file descriptor."""
+        return self._fd
+
+
+class FrameWriter(object):
+    """Encode and write zero-delimited COBS frames to a file descriptor.
+
+    Encoded frames are held until at least bufsize bytes are pending,
+    or flush() is called, and then written together. Using the writer as
+    a context manager flushes it on exit. The file descriptor is never
+    closed by the writer."""
+
+    def __init__(self, fd, bufsize=_DEFAULT_BUFSIZE, codec=None):
+        if bufsize < 1:
+            raise ValueError('bufsize must be at least 1')
+        self._codec = _check_codec(codec)
+        self._fd = fd
+        self._bufsize = bufsize
+        self._pending = []
+        self.pending_bytes = 0
+
+    def write(self, data):
+        """Encode data as one frame, followed by a zero byte delimiter, and
+        queue it for writing. Pending frames are written once at least
+        bufsize bytes are pending.
+
+        Once the frame is queued, write() doesn't raise BlockingIOError. If
+        a non-blocking file descriptor isn't ready, the data stays pending
+        for the next write() or flush()."""
+        frame = self._codec.encode(data) + b'\x00'
+        self._pending.append(frame)
+        self.pending_bytes += len(frame)
+        if self.pending_bytes >= self._bufsize:
+            try:
+                self.flush()
+            except BlockingIOError:
+                # The frame has been accepted, so a caller mustn't retry it.
+                # Only flush() reports that the data can't be written yet.
+                pass
+
+    def flush(self):
+        """Write all pending frames.
+
+        On a non-blocking file descriptor this may raise BlockingIOError,
+        in which case the unwritten data stays pending."""
+        while self._pending:
+            if hasattr(os, 'writev'):
+                write_len = os.writev(self._fd, self._pending[:256])
+            else:
+                write_len = os.write(self._fd, b''.join(self._pending))
+            self.pending_bytes -= write_len
+            while write_len > 0:
+                if write_len >= len(self._pending[0]):
+                    write_len -= len(self._pending.pop(0))
+                else:
+                    self._pending[0] = self._pending[0][write_len:]
+                    write_len = 0
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc_info):
+        self.flush()
+        return False
+
+    def fileno(self):
+        """Return the file descriptor."""
+        return self._fd
@@ -0,0 +1,235 @@
+"""
+Consistent Overhead Byte Stuffing (COBS) frame streams
+
+Unit Tests
+
+This version is for Python 3.x.
+"""
+
+import os
+import random
+import socket
+import threading
+import unittest
+
+from .. import cobs as cobs
+from .. import cobsr as cobsr
+from .. import framestream as framestream
+from ..framestream import _framestream_py as framestream_py
+
+
+def random_messages(count, max_length=600, seed=1):
+    rng = random.Random(seed)
+    return [ bytes(rng.randint(0, 255) for x in range(rng.randint(0, max_length))) for i in range(count) ]
+
+
+class FrameStreamTestsMixin(object):
+    """Tests run against each implementation. Subclasses set impl."""
+
+    def pipe(self):
+        r, w = os.pipe()
+        self.addCleanup(self.close_fd, r)
+        self.addCleanup(self.close_fd, w)
+        return r, w
+
+    def close_fd(self, fd):
+        try:
+            os.close(fd)
+        except OSError:
+            pass
+
+    def write_in_thread(self, w, messages, codec=None, bufsize=4096):
+        def writer():
+            with self.impl.FrameWriter(w, bufsize=bufsize, codec=codec) as fw:
+                for message in messages:
+                    fw.write(message)
+            os.close(w)
+        thread = threading.Thread(target=writer)
+        thread.start()
+        self.addCleanup(thread.join)
+        return thread
+
+    def test_pipe_round_trip(self):
+        messages = random_messages(300)
+        r, w = self.pipe()
+        self.write_in_thread(w, messages)
+        self.assertEqual(list(self.impl.FrameReader(r, bufsize=1024)), messages)
+
+    def test_cobsr_round_trip(self):
+        messages = random_messages(300, seed=2)
+        r, w = self.pipe()
+        self.write_in_thread(w, messages, codec=cobsr)
+        self.assertEqual(list(self.impl.FrameReader(r, bufsize=1024, codec=cobsr)), messages)
+
+    def test_socket_round_trip(self):
+        messages = random_messages(100, seed=3)
+        a, b = socket.socketpair()
+        self.addCleanup(a.close)
+        self.addCleanup(b.close)
+        w = os.dup(a.fileno())
+        a.close()
+        self.write_in_thread(w, messages)
+        self.assertEqual(list(self.impl.FrameReader(b.fileno(), bufsize=700)), messages)
+
+    @unittest.skipUnless(hasattr(os, 'openpty'), 'requires os.openpty')
+    def test_pty_round_trip(self):
+        import tty
+        messages = random_messages(20, max_length=100, seed=4)
+        master, slave = os.openpty()
+        self.addCleanup(self.close_fd, master)
+        self.addCleanup(self.close_fd, slave)
+        tty.setraw(slave)
+        with self.impl.FrameWriter(master) as fw:
+            for message in messages:
+                fw.write(message)
+        reader = self.impl.FrameReader(slave, bufsize=256)
+        self.assertEqual([ reader.read_frame() for message in messages ], messages)
+
+    def test_frames_split_across_reads(self):
+        messages = random_messages(50, seed=5)
+        data = b''.join(cobs.encode(m) + b'\x00' for m in messages)
+        r, w = self.pipe()
+        def writer():
+            for i in range(0, len(data), 7):
+                os.write(w, data[i:i+7])
+            os.close(w)
+        thread = threading.Thread(target=writer)
+        thread.start()
+        self.addCleanup(thread.join)
+        self.assertEqual(list(self.impl.FrameReader(r, bufsize=650)), messages)
+
+    def test_empty_frames_and_unterminated_final_frame(self):
+        r, w = self.pipe()
+        os.write(w, b'\x00\x00' + cobs.encode(b'abc') + b'\x00\x00' + cobs.encode(b'\x00de'))
+        os.close(w)
+        reader = self.impl.FrameReader(r)
+        self.assertEqual(reader.read_frame(), b'abc')
+        self.assertEqual(reader.read_frame(), b'\x00de')
+        self.assertIsNone(reader.read_frame())
+
+    def test_frame_too_long(self):
+        r, w = self.pipe()
+        os.write(w, cobs.encode(b'x' * 100) + b'\x00' + cobs.encode(b'ok') + b'\x00')
+        os.close(w)
+        reader = self.impl.FrameReader(r, bufsize=16)
+        with self.assertRaises(cobs.DecodeError):
+            reader.read_frame()
+        self.assertEqual(reader.read_frame(), b'ok')
+        self.assertIsNone(reader.read_frame())
+
+    def test_frame_exactly_bufsize(self):
+        for codec, message in ((cobs, b'1234567'), (cobsr, b'abcdefgz')):
+            encoded = codec.encode(message)
+            self.assertEqual(len(encoded), 8)
+            r, w = self.pipe()
+            os.write(w, encoded + b'\x00' + codec.encode(b'\x01' * 8) + b'\x00' +
+                        codec.encode(b'ok') + b'\x00' + encoded)
+            os.close(w)
+            reader = self.impl.FrameReader(r, bufsize=8, codec=codec)
+            self.assertEqual(reader.read_frame(), message)
+            with self.assertRaises(codec.DecodeError):
+                reader.read_frame()
+            self.assertEqual(reader.read_frame(), b'ok')
+            # An unterminated final frame of exactly bufsize bytes
+            self.assertEqual(reader.read_frame(), message)
+            self.assertIsNone(reader.read_frame())
+
+    def test_invalid_frame(self):
+        r, w = self.pipe()
+        os.write(w, b'\x05123\x00' + cobs.encode(b'ok') + b'\x00')
+        os.close(w)
+        reader = self.impl.FrameReader(r)
+        with self.assertRaises(cobs.DecodeError):
+            reader.read_frame()
+        self.assertEqual(reader.read_frame(), b'ok')
+
+    def test_writer_batches(self):
+        r, w = self.pipe()
+        writer = self.impl.FrameWriter(w, bufsize=100)
+        writer.write(b'12345')
+        self.assertEqual(writer.pending_bytes, 7)
+        writer.flush()
+        self.assertEqual(writer.pending_bytes, 0)
+        self.assertEqual(os.read(r, 100), b'\x0612345\x00')
+        writer.write(b'x' * 200)
+        self.assertEqual(writer.pending_bytes, 0)
+        self.assertEqual(os.read(r, 1000), cobs.encode(b'x' * 200) + b'\x00')
+
+    def test_writer_non_blocking_partial_write(self):
+        r, w = self.pipe()
+        os.set_blocking(w, False)
+        messages = random_messages(200, max_length=2000, seed=6)
+        writer = self.impl.FrameWriter(w, bufsize=1 << 30)
+        for message in messages:
+            writer.write(message)
+        with self.assertRaises(BlockingIOError):
+            writer.flush()
+        self.assertTrue(writer.pending_bytes > 0)
+
+        received = []
+        def reader():
+            received.extend(self.impl.FrameReader(r))
+        thread = threading.Thread(target=reader)
+        thread.start()
+        os.set_blocking(w, True)
+        writer.flush()
+        os.close(w)
+        thread.join()
+        self.assertEqual(received, messages)
+
+    def test_writer_write_queues_without_blocking_error(self):
+        r, w = self.pipe()
+        os.set_blocking(w, False)
+        # Fill the pipe, with empty frames
+        try:
+            while True:
+                os.write(w, b'\x00' * 65536)
+        except BlockingIOError:
+            pass
+        writer = self.impl.FrameWriter(w, bufsize=1)
+        writer.write(b'12345')
+        writer.write(b'678')
+        self.assertEqual(writer.pending_bytes, 7 + 5)
+        with self.assertRaises(BlockingIOError):
+            writer.flush()
+
+        received = []
+        def reader():
+            received.extend(self.impl.FrameReader(r))
+        thread = threading.Thread(target=reader)
+        thread.start()
+        os.set_blocking(w, True)
+        writer.flush()
+        os.close(w)
+        thread.join()
+        # Each frame is sent once
+        self.assertEqual(received, [ b'12345', b'678' ])
+
+    def test_invalid_bufsize(self):
+        for bufsize in (0, -1):
+            with self.assertRaises(ValueError):
+                self.impl.FrameReader(0, bufsize=bufsize)
+            with self.assertRaises(ValueError):
+                self.impl.FrameWriter(1, bufsize=bufsize)
+
+    def test_invalid_codec(self):
+        with self.assertRaises(ValueError):
+            self.impl.FrameReader(0, codec=random)
+        with self.assertRaises(ValueError):
+            self.impl.FrameWriter(1, codec=random)
+
+
+class FrameStreamTests(FrameStreamTestsMixin, unittest.TestCase):
+    impl = framestream
+
+
+class FrameStreamPythonTests(FrameStreamTestsMixin, unittest.TestCase):
+    impl = framestream_py
+
+
+def runtests():
+    unittest.main()
+
+
+if __name__ == '__main__':
+    runtests()
@@ -0,0 +1,40 @@
+"""
+Reverse Consistent Overhead Byte Stuffing (rCOBS) encoding and decoding.
+
+Functions are provided for encoding and decoding according to
+the rCOBS method. rCOBS is a variant of COBS in which the code
+(length) byte is placed *after* each run of data bytes, rather
+than before it. So the encoder never needs to look ahead or
+buffer a run of data before it can output it, which suits
+streaming senders. The decoder works backwards from the end of
+the encoded message.
+
+An incremental Encoder class is provided for streaming use.
+
+A pure Python implementation and a C extension implementation
+are provided. If the C extension is not available for some reason,
+the pure Python version will be used.
+"""
+
+try:
+    from ._rcobs_ext import *
+    _using_extension = True
+except ImportError:
+    from ._rcobs_py import *
+    _using_extension = False
+
+DecodeError.__module__ = 'cobs.rcobs'
+
+from .._version import *
+
+
+def encoding_overhead(source_len):
+    """Calculates the maximum overhead when encoding a message with the given length.
+    The overhead is 1 byte, plus one in 254 bytes rounded down."""
+    return 1 + source_len // 254
+
+
+def max_encoded_length(source_len):
+    """Calculates how maximum possible size of an encoded message given the length of the
+    source message."""
+    return source_len + encoding_overhead(source_len)
@@ -0,0 +1,106 @@
+"""
+Reverse Consistent Overhead Byte Stuffing (rCOBS)
+
+This version is for Python 3.x.
+"""
+
+
+class DecodeError(Exception):
+    pass
+
+
+def _get_buffer_view(in_bytes):
+    mv = memoryview(in_bytes)
+    if mv.ndim > 1 or mv.itemsize > 1:
+        raise BufferError('object must be a single-dimension buffer of bytes.')
+    try:
+        if mv.format != 'B':
+            mv = mv.cast('B')
+    except AttributeError:
+        pass
+    return mv
+
+
+class Encoder(object):
+    """Incremental rCOBS encoder.
+
+    Data passed to update() is encoded and returned immediately, without
+    waiting for the end of the run. Call finish() at the end of each
+    message to get the final code byte. The concatenation of all the
+    outputs is the same as encode() of the concatenated inputs."""
+
+    def __init__(self):
+        self._search_len = 0
+
+    def update(self, in_bytes):
+        """Encode the next piece of a message, and return the encoded bytes."""
+        if isinstance(in_bytes, str):
+            raise TypeError('Unicode-objects must be encoded as bytes first')
+        in_bytes_mv = _get_buffer_view(in_bytes)
+        out_bytes = bytearray()
+        search_len = self._search_len
+        for in_char in in_bytes_mv:
+            if in_char == 0:
+                out_bytes.append(search_len + 1)
+                search_len = 0
+            else:
+                out_bytes.append(in_char)
+                search_len += 1
+                if search_len == 0xFE:
+                    out_bytes.append(0xFF)
+                    search_len = 0
+        self._search_len = search_len
+        return bytes(out_bytes)
+
+    def finish(self):
+        """End the current message, and return its final code byte.
+        The encoder is then ready to encode the next message."""
+        code_byte = bytes([ self._search_len + 1 ])
+        self._search_len = 0
+        return code_byte
+
+
+def encode(in_bytes):
+    """Encode a string using Reverse Consistent Overhead Byte Stuffing (rCOBS).
+    
+    Input is any byte string. Output is also a byte string.
+    
+    Encoding guarantees no zero bytes in the output. The output
+    string will be expanded slightly, by a predictable amount.
+    
+    An empty string is encoded to '\\x01'"""
+    encoder = Encoder()
+    return encoder.update(in_bytes) + encoder.finish()
+
+
+def decode(in_bytes):
+    """Decode a string using Reverse Consistent Overhead Byte Stuffing (rCOBS).
+    
+    Input should be a byte string that has been rCOBS encoded. Output
+    is also a byte string.
+    
+    A rcobs.DecodeError exception will be raised if the encoded data
+    is invalid."""
+    if isinstance(in_bytes, str):
+        raise TypeError('Unicode-objects are not supported; byte buffer objects only')
+    in_bytes_mv = _get_buffer_view(in_bytes)
+    out_chunks = []
+    idx = len(in_bytes_mv)
+    final_run = True
+
+    while idx > 0:
+        length = in_bytes_mv[idx - 1]
+        if length == 0:
+            raise DecodeError("zero byte found in input")
+        start = idx - length
+        if start < 0:
+            raise DecodeError("not enough input bytes for length code")
+        copy_mv = in_bytes_mv[start:idx - 1]
+        if 0 in copy_mv:
+            raise DecodeError("zero byte found in input")
+        if not final_run and length < 0xFF:
+            out_chunks.append(b'\x00')
+        final_run = False
+        out_chunks.append(copy_mv)
+        idx = start
+    return b''.join(reversed(out_chunks))
@@ -0,0 +1,265 @@
+"""
+Reverse Consistent Overhead Byte Stuffing (rCOBS)
+
+Unit Tests
+
+This version is for Python 3.x.
+"""
+
+from array import array
+import random
+import unittest
+
+from .. import rcobs as rcobs
+from ..rcobs import _rcobs_py as rcobs_py
+
+
+def infinite_non_zero_generator():
+    while True:
+        for i in range(1,50):
+            for j in range(1,256, i):
+                yield j
+
+def non_zero_generator(length):
+    non_zeros = infinite_non_zero_generator()
+    for i in range(length):
+        yield next(non_zeros)
+
+def non_zero_bytes(length):
+    return b''.join(bytes([i]) for i in non_zero_generator(length))
+
+
+class PredefinedEncodingsTests(unittest.TestCase):
+    predefined_encodings = [
+        [ b"",                                  b"\x01"                                                         ],
+        [ b"1",                                 b"1\x02"                                                        ],
+        [ b"12345",                             b"12345\x06"                                                    ],
+        [ b"12345\x006789",                     b"12345\x066789\x05"                                            ],
+        [ b"\x0012345\x006789",                 b"\x0112345\x066789\x05"                                        ],
+        [ b"12345\x006789\x00",                 b"12345\x066789\x05\x01"                                        ],
+        [ b"\x00",                              b"\x01\x01"                                                     ],
+        [ b"\x00\x00",                          b"\x01\x01\x01"                                                 ],
+        [ b"\x00\x00\x00",                      b"\x01\x01\x01\x01"                                             ],
+        [ bytes(bytearray(range(1, 254))),      bytes(bytearray(range(1, 254)) + b"\xfe")                       ],
+        [ bytes(bytearray(range(1, 255))),      bytes(bytearray(range(1, 255)) + b"\xff\x01")                   ],
+        [ bytes(bytearray(range(1, 256))),      bytes(bytearray(range(1, 255)) + b"\xff\xff\x02")               ],
+        [ bytes(bytearray(range(0, 256))),      bytes(b"\x01" + bytearray(range(1, 255)) + b"\xff\xff\x02")     ],
+    ]
+
+    def test_predefined_encodings(self):
+        for (test_string, expected_encoded_string) in self.predefined_encodings:
+            encoded = rcobs.encode(test_string)
+            self.assertEqual(encoded, expected_encoded_string)
+
+    def test_decode_predefined_encodings(self):
+        for (test_string, expected_encoded_string) in self.predefined_encodings:
+            decoded = rcobs.decode(expected_encoded_string)
+            self.assertEqual(test_string, decoded)
+
+    def test_python_implementation(self):
+        for (test_string, expected_encoded_string) in self.predefined_encodings:
+            self.assertEqual(rcobs_py.encode(test_string), expected_encoded_string)
+            self.assertEqual(rcobs_py.decode(expected_encoded_string), test_string)
+
+
+class PredefinedDecodeErrorTests(unittest.TestCase):
+    decode_error_test_strings = [
+        b"\x00",
+        b"123\x05",
+        b"\x001234\x05",
+        b"12\x004\x05",
+    ]
+
+    def test_predefined_decode_error(self):
+        for test_encoded in self.decode_error_test_strings:
+            with self.assertRaises(rcobs.DecodeError):
+                rcobs.decode(test_encoded)
+            with self.assertRaises(rcobs_py.DecodeError):
+                rcobs_py.decode(test_encoded)
+
+
+class ZerosTest(unittest.TestCase):
+    def test_zeros(self):
+        for length in range(520):
+            test_string = b'\x00' * length
+            encoded = rcobs.encode(test_string)
+            expected_encoded = b'\x01' * (length + 1)
+            self.assertEqual(encoded, expected_encoded, "encoding zeros failed for length %d" % length)
+            decoded = rcobs.decode(encoded)
+            self.assertEqual(decoded, test_string, "decoding zeros failed for length %d" % length)
+
+
+class NonZerosTest(unittest.TestCase):
+    def simple_encode_non_zeros_only(self, in_bytes):
+        out_list = []
+        for i in range(0, len(in_bytes), 254):
+            data_block = in_bytes[i: i+254]
+            out_list.append(data_block)
+            out_list.append(bytes([ len(data_block) + 1 ]))
+        if len(in_bytes) % 254 == 0:
+            out_list.append(b'\x01')
+        return b''.join(out_list)
+
+    def test_non_zeros(self):
+        for length in range(1, 1000):
+            test_string = non_zero_bytes(length)
+            encoded = rcobs.encode(test_string)
+            expected_encoded = self.simple_encode_non_zeros_only(test_string)
+            self.assertEqual(encoded, expected_encoded,
+                             "encoded != expected_encoded for length %d\nencoded: %s\nexpected_encoded: %s" %
+                             (length, repr(encoded), repr(expected_encoded)))
+            self.assertEqual(rcobs.decode(encoded), test_string)
+
+
+class RandomDataTest(unittest.TestCase):
+    NUM_TESTS = 5000
+    MAX_LENGTH = 2000
+
+    def test_random(self):
+        try:
+            for _test_num in range(self.NUM_TESTS):
+                length = random.randint(0, self.MAX_LENGTH)
+                test_string = bytes(random.randint(0,255) for x in range(length))
+                encoded = rcobs.encode(test_string)
+                self.assertTrue(b'\x00' not in encoded,
+                                "encoding contains zero byte(s):\noriginal: %s\nencoded: %s" % (repr(test_string), repr(encoded)))
+                self.assertTrue(len(encoded) <= rcobs.max_encoded_length(len(test_string)),
+                                "encoding too big:\noriginal: %s\nencoded: %s" % (repr(test_string), repr(encoded)))
+                decoded = rcobs.decode(encoded)
+                self.assertEqual(decoded, test_string,
+                                 "encoding and decoding random data failed:\noriginal: %s\ndecoded: %s" % (repr(test_string), repr(decoded)))
+        except KeyboardInterrupt:
+            pass
+
+    def test_random_python_implementation(self):
+        for _test_num in range(200):
+            length = random.randint(0, self.MAX_LENGTH)
+            test_string = bytes(random.randint(0,255) for x in range(length))
+            encoded = rcobs.encode(test_string)
+            self.assertEqual(rcobs_py.encode(test_string), encoded)
+            self.assertEqual(rcobs_py.decode(encoded), test_string)
+
+
+class EncoderTest(unittest.TestCase):
+    def check_encoder(self, encoder_class, test_string, chunk_size):
+        encoder = encoder_class()
+        out_list = []
+        for i in range(0, len(test_string), chunk_size):
+            out_list.append(encoder.update(test_string[i: i+chunk_size]))
+        out_list.append(encoder.finish())
+        self.assertEqual(b''.join(out_list), rcobs.encode(test_string))
+
+    def test_encoder_chunks(self):
+        test_strings = [
+            b"",
+            b"12345\x006789\x00",
+            non_zero_bytes(1000),
+            bytes(bytearray(range(0, 256))) * 4,
+        ]
+        for encoder_class in (rcobs.Encoder, rcobs_py.Encoder):
+            for test_string in test_strings:
+                for chunk_size in (1, 2, 7, 253, 254, 255, 1000):
+                    self.check_encoder(encoder_class, test_string, chunk_size)
+
+    def test_encoder_output_is_immediate(self):
+        """Each non-zero input byte is output as soon as it is passed to update()."""
+        encoder = rcobs.Encoder()
+        self.assertEqual(encoder.update(b"1"), b"1")
+        self.assertEqual(encoder.update(b"\x00"), b"\x02")
+        self.assertEqual(encoder.update(b"23"), b"23")
+        self.assertEqual(encoder.finish(), b"\x03")
+
+    def test_encoder_reuse(self):
+        encoder = rcobs.Encoder()
+        first = encoder.update(b"abc") + encoder.finish()
+        second = encoder.update(b"abc") + encoder.finish()
+        self.assertEqual(first, second)
+
+
+class InputTypesTest(unittest.TestCase):
+    predefined_encodings = [
+        [ b"",                                  b"\x01"                                                         ],
+        [ b"1",                                 b"1\x02"                                                        ],
+        [ b"12345",                             b"12345\x06"                                                    ],
+        [ b"12345\x006789",                     b"12345\x066789\x05"                                            ],
+        [ b"\x0012345\x006789",                 b"\x0112345\x066789\x05"                                        ],
+        [ b"12345\x006789\x00",                 b"12345\x066789\x05\x01"                                        ],
+    ]
+
+    def test_unicode_string(self):
+        """Test that Unicode strings are not encoded or decoded.
+        They should raise a TypeError."""
+        for (test_string, expected_encoded_string) in self.predefined_encodings:
+            unicode_test_string = test_string.decode('latin')
+            with self.assertRaises(TypeError):
+                rcobs.encode(unicode_test_string)
+            unicode_encoded_string = expected_encoded_string.decode('latin')
+            with self.assertRaises(TypeError):
+                rcobs.decode(unicode_encoded_string)
+
+    def test_bytearray(self):
+        """Test that bytearray objects can be encoded or decoded."""
+        for (test_string, expected_encoded_string) in self.predefined_encodings:
+            bytearray_test_string = bytearray(test_string)
+            encoded = rcobs.encode(bytearray_test_string)
+            self.assertEqual(encoded, expected_encoded_string)
+            bytearray_encoded_string = bytearray(expected_encoded_string)
+            decoded = rcobs.decode(bytearray_encoded_string)
+            self.assertEqual(decoded, test_string)
+
+    def test_array_of_bytes(self):
+        """Test that array of bytes objects (array('B', ...)) can be encoded or decoded."""
+        for (test_string, expected_encoded_string) in self.predefined_encodings:
+            array_test_string = array('B', test_string)
+            encoded = rcobs.encode(array_test_string)
+            self.assertEqual(encoded, expected_encoded_string)
+            array_encoded_string = array('B', expected_encoded_string)
+            decoded = rcobs.decode(array_encoded_string)
+            self.assertEqual(decoded, test_string)
+
+    def test_memoryview(self):
+        """Test that memoryview objects, including slices, can be encoded or decoded."""
+        for (test_string, expected_encoded_string) in self.predefined_encodings:
+            encoded = rcobs.encode(memoryview(b'_' + test_string + b'_')[1:-1])
+            self.assertEqual(encoded, expected_encoded_string)
+            decoded = rcobs.decode(memoryview(b'_' + expected_encoded_string + b'_')[1:-1])
+            self.assertEqual(decoded, test_string)
+
+    def test_array_of_half_words(self):
+        """Test that array of half-word objects (array('H', ...)) are not encoded or decoded.
+        They should raise a BufferError."""
+        typecodes = [ 'H', 'h', 'i', 'I', 'l', 'L', 'f', 'd' ]
+        for typecode in typecodes:
+            array_test_string = array(typecode, [ 49, 50, 51, 52, 53 ])
+            with self.assertRaises(BufferError):
+                rcobs.encode(array_test_string)
+            array_encoded_string = array(typecode, [ 49, 50, 51, 52, 53, 6 ])
+            with self.assertRaises(BufferError):
+                rcobs.decode(array_encoded_string)
+
+
+class UtilTests(unittest.TestCase):
+
+    def test_encoded_len_calc(self):
+        self.assertEqual(rcobs.encoding_overhead(5), 1)
+        self.assertEqual(rcobs.max_encoded_length(5), 6)
+
+    def test_encoded_len_calc_empty_packet(self):
+        self.assertEqual(rcobs.encoding_overhead(0), 1)
+        self.assertEqual(rcobs.max_encoded_length(0), 1)
+
+    def test_encoded_len_calc_253(self):
+        self.assertEqual(rcobs.encoding_overhead(253), 1)
+        self.assertEqual(rcobs.max_encoded_length(253), 254)
+
+    def test_encoded_len_calc_two_byte_overhead(self):
+        self.assertEqual(rcobs.encoding_overhead(254), 2)
+        self.assertEqual(rcobs.max_encoded_length(254), 256)
+
+
+def runtests():
+    unittest.main()
+
+
+if __name__ == '__main__':
+    runtests()
@@ -0,0 +1,97 @@
+"""
+cffi build script for the cobs._cffi_kernels module.
+
+This compiles the same C kernels as the C API extensions (cobs_kernel.h
+and cobsr_kernel.h) into a cffi module. On PyPy, calls through cffi are
+much faster than calls to a C API extension, which go through the cpyext
+compatibility layer.
+
+It is used by setup.py via cffi_modules. It can also be run directly to
+build the module in the current directory.
+"""
+
+import os
+
+from cffi import FFI
+
+
+EXT_DIR = os.path.dirname(os.path.abspath(__file__))
+
+ffibuilder = FFI()
+
+ffibuilder.cdef("""
+    size_t cobs_encode_buf(const char * src_ptr, size_t src_len, char * dst_buf_ptr);
+    int cobs_decode_buf(const char * src_ptr, size_t src_len, char * dst_buf_ptr, size_t * dst_len_ptr);
+    size_t cobsr_encode_buf(const char * src_ptr, size_t src_len, char * dst_buf_ptr);
+    int cobsr_decode_buf(const char * src_ptr, size_t src_len, char * dst_buf_ptr, size_t * dst_len_ptr);
+    size_t cobs_run_len(const char * src_ptr, size_t src_len);
+
+    #define COBS_DECODE_OK ...
+    #define COBS_DECODE_ZERO_BYTE ...
+    #define COBS_DECODE_NOT_ENOUGH_INPUT ...
+""")
+
+ffibuilder.set_source("cobs._cffi_kernels", """
+#include <string.h>
+
+#include "cobs_kernel.h"
+#include "cobsr_kernel.h"
+
+static size_t
+cobs_encode_buf(const char * src_ptr, size_t src_len, char * dst_buf_ptr)
+{
+    return cobs_encode_run(src_ptr, src_len, dst_buf_ptr) - dst_buf_ptr;
+}
+
+static int
+cobs_decode_buf(const char * src_ptr, size_t src_len, char * dst_buf_ptr, size_t * dst_len_ptr)
+{
+    char *                  dst_write_ptr;
+    cobs_decode_status_t    status;
+
+    dst_write_ptr = dst_buf_ptr;
+    status = COBS_DECODE_OK;
+    if (src_len != 0)
+    {
+        status = cobs_decode_run(src_ptr, src_ptr + src_len, &dst_write_ptr, 1);
+    }
+    *dst_len_ptr = dst_write_ptr - dst_buf_ptr;
+    return status;
+}
+
+static size_t
+cobsr_encode_buf(const char * src_ptr, size_t src_len, char * dst_buf_ptr)
+{
+    return cobsr_encode_run(src_ptr, src_len, dst_buf_ptr) - dst_buf_ptr;
+}
+
+static int
+cobsr_decode_buf(const char * src_ptr, size_t src_len, char * dst_buf_ptr, size_t * dst_len_ptr)
+{
+    char *                  dst_write_ptr;
+    cobsr_decode_status_t   status;
+
+    dst_write_ptr = dst_buf_ptr;
+    status = cobsr_decode_run(src_ptr, src_len, &dst_write_ptr);
+    *dst_len_ptr = dst_write_ptr - dst_buf_ptr;
+    /* COBS/R decoding can only fail on a zero byte */
+    return (status == COBSR_DECODE_OK) ? COBS_DECODE_OK : COBS_DECODE_ZERO_BYTE;
+}
+
+/* Length of the run of non-zero bytes at src_ptr, up to src_len, for encode_iov */
+static size_t
+cobs_run_len(const char * src_ptr, size_t src_len)
+{
+    const char *    zero_ptr;
+
+    zero_ptr = memchr(src_ptr, 0, src_len);
+    return (zero_ptr != NULL) ? (size_t) (zero_ptr - src_ptr) : src_len;
+}
+""",
+    include_dirs=[ EXT_DIR, ],
+    depends=[ os.path.join(EXT_DIR, 'cobs_kernel.h'), os.path.join(EXT_DIR, 'cobsr_kernel.h'), ],
+)
+
+
+if __name__ == '__main__':
+    ffibuilder.compile(verbose=True)
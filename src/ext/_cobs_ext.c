@@ -32,6 +32,16 @@
 // Force Py_ssize_t to be used for s# conversions.
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <string.h>
+
+#include "cobs_kernel.h"
+#include "cobs_py_helpers.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
 
 
 /*****************************************************************************
@@ -61,7 +71,7 @@
                             "object supporting the buffer API is required"); \
             return NULL; \
         } \
-        if (PyObject_GetBuffer((obj), (viewp), PyBUF_FORMAT) == -1) { \
+        if (PyObject_GetBuffer((obj), (viewp), PyBUF_ND | PyBUF_FORMAT) == -1) { \
             return NULL; \
         } \
         if (((viewp)->ndim > 1) || ((viewp)->itemsize > 1)) { \
@@ -73,8 +83,16 @@
     } while(0);
 
 
-#define COBS_ENCODE_DST_BUF_LEN_MAX(SRC_LEN)            ((SRC_LEN) + ((SRC_LEN)/254u) + 1)
-#define COBS_DECODE_DST_BUF_LEN_MAX(SRC_LEN)            (((SRC_LEN) <= 1) ? 1 : ((SRC_LEN) - 1))
+/* Inputs are only split for parallel encoding or decoding into segments of
+ * at least this size. Below that, the cost of starting threads outweighs the
+ * gain. */
+#define COBS_PARALLEL_MIN_SEGMENT_LEN                   (256 * 1024)
+
+/* Output space for a parallel encode. Each segment gets a slot sized for its
+ * own worst case, and the rounding of each slot's length code overhead can add
+ * up to one byte per segment over the worst case for the whole input. */
+#define COBS_ENCODE_PARALLEL_DST_BUF_LEN_MAX(SRC_LEN, NUM_SEGMENTS) \
+    (COBS_ENCODE_DST_BUF_LEN_MAX(SRC_LEN) + (NUM_SEGMENTS))
 
 
 /*****************************************************************************
@@ -88,6 +106,46 @@ struct module_state
 };
 
 
+typedef void (*cobs_job_func_t)(void * job);
+
+struct cobs_thread
+{
+    cobs_job_func_t     func;
+    void *              job;
+    int                 started;
+#ifdef _WIN32
+    HANDLE              handle;
+#else
+    pthread_t           handle;
+#endif
+};
+
+
+/* One segment of a parallel encode. */
+struct cobs_encode_job
+{
+    const char *        src_ptr;
+    Py_ssize_t          src_len;
+    char *              dst_buf_ptr;
+    Py_ssize_t          dst_len;
+    /* TRUE if the segment ends with a zero byte, and is not the last segment.
+     * Then the final (empty) run's code byte is dropped; the next segment
+     * supplies it. */
+    int                 ends_with_zero;
+};
+
+
+/* One segment of a parallel decode. */
+struct cobs_decode_job
+{
+    const char *        src_ptr;
+    const char *        src_end_ptr;
+    char *              dst_buf_ptr;
+    int                 is_final;
+    cobs_decode_status_t status;
+};
+
+
 /*****************************************************************************
  * Functions
  ****************************************************************************/
@@ -106,6 +164,310 @@ static int cobs_clear(PyObject *m)
 }
 
 
+/*
+ * Parse the optional threads argument. Returns the number of segments to
+ * split an input of src_len bytes into, or -1 with an exception set.
+ */
+static Py_ssize_t
+cobs_num_segments(Py_ssize_t threads, Py_ssize_t src_len)
+{
+    Py_ssize_t      num_segments;
+
+
+    if (threads < 1)
+    {
+        PyErr_SetString(PyExc_ValueError, "threads must be at least 1");
+        return -1;
+    }
+    num_segments = src_len / COBS_PARALLEL_MIN_SEGMENT_LEN;
+    if (num_segments > threads)
+    {
+        num_segments = threads;
+    }
+    if (num_segments < 1)
+    {
+        num_segments = 1;
+    }
+    return num_segments;
+}
+
+
+#ifdef _WIN32
+static DWORD WINAPI
+cobs_thread_entry(LPVOID arg)
+{
+    struct cobs_thread * thread = arg;
+
+    thread->func(thread->job);
+    return 0;
+}
+#else
+static void *
+cobs_thread_entry(void * arg)
+{
+    struct cobs_thread * thread = arg;
+
+    thread->func(thread->job);
+    return NULL;
+}
+#endif
+
+
+/*
+ * Run func on each of num_jobs jobs, each job_size bytes long, in parallel.
+ * The first job runs on the calling thread. If a thread can't be started,
+ * its job is run on the calling thread instead.
+ *
+ * This doesn't touch any Python objects, so it can be called with the GIL
+ * released.
+ */
+static void
+cobs_run_parallel(cobs_job_func_t func, void * jobs, size_t job_size, Py_ssize_t num_jobs)
+{
+    struct cobs_thread *    threads;
+    Py_ssize_t              i;
+
+
+    if (num_jobs < 1)
+    {
+        return;
+    }
+    threads = calloc((size_t) num_jobs, sizeof(struct cobs_thread));
+    if (threads != NULL)
+    {
+        for (i = 1; i < num_jobs; i++)
+        {
+            threads[i].func = func;
+            threads[i].job = (char *) jobs + i * job_size;
+#ifdef _WIN32
+            threads[i].handle = CreateThread(NULL, 0, cobs_thread_entry, &threads[i], 0, NULL);
+            threads[i].started = (threads[i].handle != NULL);
+#else
+            threads[i].started = (pthread_create(&threads[i].handle, NULL, cobs_thread_entry, &threads[i]) == 0);
+#endif
+        }
+    }
+
+    func(jobs);
+
+    for (i = 1; i < num_jobs; i++)
+    {
+        if (threads != NULL && threads[i].started)
+        {
+#ifdef _WIN32
+            WaitForSingleObject(threads[i].handle, INFINITE);
+            CloseHandle(threads[i].handle);
+#else
+            pthread_join(threads[i].handle, NULL);
+#endif
+        }
+        else
+        {
+            func((char *) jobs + i * job_size);
+        }
+    }
+    free(threads);
+}
+
+
+static void
+cobs_encode_job_encode(void * arg)
+{
+    struct cobs_encode_job * job = arg;
+    char * dst_end_ptr;
+
+
+    dst_end_ptr = cobs_encode_run(job->src_ptr, job->src_len, job->dst_buf_ptr);
+    job->dst_len = dst_end_ptr - job->dst_buf_ptr;
+    if (job->ends_with_zero)
+    {
+        job->dst_len--;
+    }
+}
+
+
+/*
+ * Find the points at which to split the input for a parallel encode.
+ *
+ * The encoder state depends only on the number of non-zero bytes since the
+ * last zero byte (or the start). So the encoder starts from a fresh state,
+ * independent of earlier input, just after a zero byte, and every 254 bytes
+ * after that in a run of non-zero bytes. Each segment is split at such a
+ * point, so that it encodes to exactly the same bytes as the serial encoder
+ * produces for it.
+ *
+ * last_zero[k] is the offset of the last zero byte before nominal boundary k,
+ * or -1 if there is none. split[k] receives the start offset of segment k.
+ * Returns the number of segments, which may be less than num_segments.
+ */
+static Py_ssize_t
+cobs_encode_find_splits(const char * src_ptr, Py_ssize_t src_len, Py_ssize_t num_segments,
+                        const Py_ssize_t * last_zero, Py_ssize_t * split)
+{
+    Py_ssize_t      count;
+    Py_ssize_t      k;
+    Py_ssize_t      boundary;
+    Py_ssize_t      run_start;
+    Py_ssize_t      pos;
+    const char *    zero_ptr;
+
+
+    split[0] = 0;
+    count = 1;
+    for (k = 1; k < num_segments; k++)
+    {
+        boundary = src_len / num_segments * k;
+
+        /* Start of the run of non-zero bytes that boundary is in */
+        run_start = last_zero[k] + 1;
+        if (run_start < split[count - 1])
+        {
+            run_start = split[count - 1];
+        }
+
+        /* Next fresh point at or after boundary */
+        pos = run_start + (boundary - run_start + 253) / 254 * 254;
+        if (pos > boundary)
+        {
+            zero_ptr = memchr(src_ptr + boundary, 0, pos - boundary);
+            if (zero_ptr != NULL)
+            {
+                pos = zero_ptr - src_ptr + 1;
+            }
+        }
+
+        if (pos > split[count - 1] && pos < src_len)
+        {
+            split[count++] = pos;
+        }
+    }
+    return count;
+}
+
+
+/*
+ * State for finding the last zero byte in each nominal segment in parallel.
+ */
+struct cobs_zero_search_job
+{
+    const char *        src_ptr;
+    Py_ssize_t          start;
+    Py_ssize_t          end;
+    Py_ssize_t          last_zero;
+};
+
+
+static void
+cobs_zero_search_job_run(void * arg)
+{
+    struct cobs_zero_search_job * job = arg;
+    Py_ssize_t i;
+
+
+    job->last_zero = -1;
+    for (i = job->end; i > job->start; i--)
+    {
+        if (job->src_ptr[i - 1] == 0)
+        {
+            job->last_zero = i - 1;
+            break;
+        }
+    }
+}
+
+
+/*
+ * Encode in parallel. Returns the encoded length, or -1 if memory couldn't be
+ * allocated. dst_buf_ptr must have room for
+ * COBS_ENCODE_PARALLEL_DST_BUF_LEN_MAX(src_len, num_segments) bytes.
+ *
+ * Each segment is encoded into its own slot of the output, sized for its worst
+ * case. The slots are then moved together in order. Each segment only moves
+ * towards the start of the output, and never past the start of its own slot,
+ * so a segment can't overwrite one that hasn't been moved yet.
+ *
+ * This doesn't touch any Python objects, so it is called with the GIL released.
+ */
+static Py_ssize_t
+cobs_encode_parallel(const char * src_ptr, Py_ssize_t src_len, char * dst_buf_ptr, Py_ssize_t num_segments)
+{
+    struct cobs_zero_search_job *   search_jobs;
+    struct cobs_encode_job *        jobs;
+    Py_ssize_t *                    last_zero;
+    Py_ssize_t *                    split;
+    Py_ssize_t                      count;
+    Py_ssize_t                      dst_len;
+    Py_ssize_t                      k;
+    Py_ssize_t                      seg_end;
+    char *                          slot_ptr;
+    int                             ok;
+
+
+    ok = FALSE;
+    dst_len = -1;
+    search_jobs = calloc(num_segments, sizeof(*search_jobs));
+    jobs = calloc(num_segments, sizeof(*jobs));
+    last_zero = calloc(num_segments, sizeof(*last_zero));
+    split = calloc(num_segments, sizeof(*split));
+    if (search_jobs == NULL || jobs == NULL || last_zero == NULL || split == NULL)
+    {
+        goto done;
+    }
+
+    /* Find the last zero byte before each nominal segment boundary. Each
+     * search is bounded by the previous nominal boundary. */
+    for (k = 0; k < num_segments; k++)
+    {
+        search_jobs[k].src_ptr = src_ptr;
+        search_jobs[k].start = (k == 0) ? 0 : src_len / num_segments * (k - 1);
+        search_jobs[k].end = src_len / num_segments * k;
+    }
+    cobs_run_parallel(cobs_zero_search_job_run, search_jobs, sizeof(*search_jobs), num_segments);
+    for (k = 0; k < num_segments; k++)
+    {
+        last_zero[k] = search_jobs[k].last_zero;
+        if (last_zero[k] < 0 && k > 0)
+        {
+            last_zero[k] = last_zero[k - 1];
+        }
+    }
+
+    count = cobs_encode_find_splits(src_ptr, src_len, num_segments, last_zero, split);
+
+    /* Encode each segment into its slot of the output */
+    slot_ptr = dst_buf_ptr;
+    for (k = 0; k < count; k++)
+    {
+        seg_end = (k + 1 < count) ? split[k + 1] : src_len;
+        jobs[k].src_ptr = src_ptr + split[k];
+        jobs[k].src_len = seg_end - split[k];
+        jobs[k].ends_with_zero = (k + 1 < count) && (src_ptr[seg_end - 1] == 0);
+        jobs[k].dst_buf_ptr = slot_ptr;
+        slot_ptr += COBS_ENCODE_DST_BUF_LEN_MAX(jobs[k].src_len);
+    }
+    cobs_run_parallel(cobs_encode_job_encode, jobs, sizeof(*jobs), count);
+
+    /* Move the segments together */
+    dst_len = 0;
+    for (k = 0; k < count; k++)
+    {
+        if (jobs[k].dst_buf_ptr != dst_buf_ptr + dst_len)
+        {
+            memmove(dst_buf_ptr + dst_len, jobs[k].dst_buf_ptr, jobs[k].dst_len);
+        }
+        dst_len += jobs[k].dst_len;
+    }
+    ok = TRUE;
+
+done:
+    free(search_jobs);
+    free(jobs);
+    free(last_zero);
+    free(split);
+    return ok ? dst_len : -1;
+}
+
+
 /*
  * cobs.encode
  */
@@ -117,104 +479,213 @@ PyDoc_STRVAR(cobs_encode__doc__,
     "Encoding guarantees no zero bytes in the output. The output\n"
     "string will be expanded slightly, by a predictable amount.\n"
     "\n"
-    "An empty string is encoded to '\\x01'."
+    "An empty string is encoded to '\\x01'.\n"
+    "\n"
+    "For a large input, threads may be set greater than 1 to split\n"
+    "the input and encode the parts in parallel. The output is the\n"
+    "same as for a serial encode.\n"
+    "\n"
+    "If any of headroom, tailroom or delimiter is given (not None),\n"
+    "the output is a bytearray, even if they are zero or false. It has\n"
+    "headroom zero bytes before the encoded data, then a zero byte\n"
+    "delimiter if delimiter is true, then tailroom zero bytes. Link\n"
+    "layer headers and trailers can then be filled in without copying\n"
+    "the encoded data again."
 );
 
 /*
- * This Python C extension function uses arguments method METH_O,
- * meaning the arg parameter contains the single parameter
- * to the function.
+ * This Python C extension function uses arguments method
+ * METH_VARARGS | METH_KEYWORDS, so that the optional threads,
+ * headroom, tailroom and delimiter parameters can be given by keyword.
  */
 static PyObject*
-cobs_encode(PyObject* module, PyObject* arg)
+cobs_encode(PyObject* module, PyObject* args, PyObject* kwds)
 {
+    static char *   kwlist[] = { "in_bytes", "threads", "headroom", "tailroom", "delimiter", NULL };
+    PyObject *      arg;
+    Py_ssize_t      threads;
+    PyObject *      headroom_obj;
+    PyObject *      tailroom_obj;
+    PyObject *      delimiter_obj;
+    Py_ssize_t      headroom;
+    Py_ssize_t      tailroom;
+    int             delimiter;
+    int             framed;
+    Py_ssize_t      frame_room;
+    Py_ssize_t      num_segments;
     Py_buffer       src_py_buffer;
     const char *    src_ptr;
     Py_ssize_t      src_len;
-    const char *    src_end_ptr;
     char *          dst_buf_ptr;
-    char *          dst_code_write_ptr;
-    char *          dst_write_ptr;
-    char            src_byte;
-    unsigned char   search_len;
+    Py_ssize_t      dst_len_max;
+    Py_ssize_t      dst_len;
     PyObject *      dst_py_obj_ptr;
 
 
+    threads = 1;
+    headroom_obj = NULL;
+    tailroom_obj = NULL;
+    delimiter_obj = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|n$OOO:encode", kwlist,
+                                     &arg, &threads, &headroom_obj, &tailroom_obj, &delimiter_obj))
+    {
+        return NULL;
+    }
     if (PyUnicode_Check((arg)))
     {
         PyErr_SetString(PyExc_TypeError,
                         "Unicode-objects must be encoded as bytes first");
         return NULL;
     }
+    framed = cobs_py_frame_args(headroom_obj, tailroom_obj, delimiter_obj, &headroom, &tailroom, &delimiter);
+    if (framed < 0)
+    {
+        return NULL;
+    }
+    frame_room = headroom + tailroom + (delimiter ? 1 : 0);
     GET_BUFFER_VIEW_OR_ERROUT(arg, &src_py_buffer);
     src_ptr = src_py_buffer.buf;
     src_len = src_py_buffer.len;
 
-    src_end_ptr = src_ptr + src_len;
+    num_segments = cobs_num_segments(threads, src_len);
+    if (num_segments < 0)
+    {
+        PyBuffer_Release(&src_py_buffer);
+        return NULL;
+    }
 
     /* Make an output string */
-    dst_py_obj_ptr = PyBytes_FromStringAndSize(NULL, COBS_ENCODE_DST_BUF_LEN_MAX(src_len));
+    dst_len_max = (num_segments > 1) ? COBS_ENCODE_PARALLEL_DST_BUF_LEN_MAX(src_len, num_segments)
+                                     : COBS_ENCODE_DST_BUF_LEN_MAX(src_len);
+    dst_py_obj_ptr = cobs_py_encode_output_new(framed, dst_len_max, frame_room, &dst_buf_ptr);
     if (dst_py_obj_ptr == NULL)
     {
+        PyBuffer_Release(&src_py_buffer);
         return NULL;
     }
-    dst_buf_ptr = PyBytes_AsString(dst_py_obj_ptr);
+    dst_buf_ptr += headroom;
 
     /* Encode */
-    dst_code_write_ptr  = dst_buf_ptr;
-    dst_write_ptr = dst_code_write_ptr + 1;
-    search_len = 1;
-
-    /* Iterate over the source bytes */
-    if (src_len != 0)
+    if (num_segments > 1)
     {
-        for (;;)
+        Py_BEGIN_ALLOW_THREADS
+        dst_len = cobs_encode_parallel(src_ptr, src_len, dst_buf_ptr, num_segments);
+        Py_END_ALLOW_THREADS
+        if (dst_len < 0)
         {
-            src_byte = *src_ptr++;
-            if (src_byte == 0)
-            {
-                /* We found a zero byte */
-                *dst_code_write_ptr = (char) search_len;
-                dst_code_write_ptr = dst_write_ptr++;
-                search_len = 1;
-                if (src_ptr >= src_end_ptr)
-                {
-                    break;
-                }
-            }
-            else
-            {
-                /* Copy the non-zero byte to the destination buffer */
-                *dst_write_ptr++ = src_byte;
-                search_len++;
-                if (src_ptr >= src_end_ptr)
-                {
-                    break;
-                }
-                if (search_len == 0xFF)
-                {
-                    /* We have a long string of non-zero bytes */
-                    *dst_code_write_ptr = (char) search_len;
-                    dst_code_write_ptr = dst_write_ptr++;
-                    search_len = 1;
-                }
-            }
+            PyBuffer_Release(&src_py_buffer);
+            Py_DECREF(dst_py_obj_ptr);
+            return PyErr_NoMemory();
         }
     }
+    else
+    {
+        dst_len = cobs_encode_run(src_ptr, src_len, dst_buf_ptr) - dst_buf_ptr;
+    }
 
     /* We're done with the input buffer now, so we have to release the PyBuffer. */
     PyBuffer_Release(&src_py_buffer);
 
-    /* We've reached the end of the source data.
-     * Finalise the remaining output. In particular, write the code (length) byte.
-     * Update the pointer to calculate the final output length.
-     */
-    *dst_code_write_ptr = (char) search_len;
+    /* Set the output length */
+    return cobs_py_encode_output_finish(dst_py_obj_ptr, framed, dst_len, headroom, tailroom, delimiter);
+}
 
-    /* Calculate the output length, from the value of dst_code_write_ptr */
-    _PyBytes_Resize(&dst_py_obj_ptr, dst_write_ptr - dst_buf_ptr);
 
-    return dst_py_obj_ptr;
+static void
+cobs_decode_job_run(void * arg)
+{
+    struct cobs_decode_job * job = arg;
+    char * dst_write_ptr;
+
+
+    dst_write_ptr = job->dst_buf_ptr;
+    job->status = cobs_decode_run(job->src_ptr, job->src_end_ptr, &dst_write_ptr, job->is_final);
+}
+
+
+/*
+ * Decode in parallel. Returns the decoded length, -1 if the encoded data is
+ * invalid, or -2 if memory couldn't be allocated. dst_buf_ptr must have room
+ * for COBS_DECODE_DST_BUF_LEN_MAX(src_len) bytes.
+ *
+ * First the chain of code bytes is followed, to find split points at run
+ * boundaries and the output offset of each segment. Then the segments are
+ * validated and copied in parallel.
+ *
+ * This doesn't touch any Python objects, so it is called with the GIL released.
+ */
+static Py_ssize_t
+cobs_decode_parallel(const char * src_ptr, Py_ssize_t src_len, char * dst_buf_ptr, Py_ssize_t num_segments)
+{
+    struct cobs_decode_job *    jobs;
+    const unsigned char *       code_ptr;
+    Py_ssize_t                  idx;
+    Py_ssize_t                  next_idx;
+    Py_ssize_t                  dst_len;
+    Py_ssize_t                  boundary;
+    Py_ssize_t                  count;
+    Py_ssize_t                  k;
+    unsigned char               len_code;
+
+
+    jobs = calloc(num_segments, sizeof(*jobs));
+    if (jobs == NULL)
+    {
+        return -2;
+    }
+
+    /* Follow the chain of code bytes */
+    code_ptr = (const unsigned char *) src_ptr;
+    idx = 0;
+    dst_len = 0;
+    count = 0;
+    boundary = 0;
+    while (idx < src_len)
+    {
+        if (idx >= boundary && count < num_segments)
+        {
+            jobs[count].src_ptr = src_ptr + idx;
+            jobs[count].dst_buf_ptr = dst_buf_ptr + dst_len;
+            count++;
+            boundary = src_len / num_segments * count;
+        }
+        len_code = code_ptr[idx];
+        if (len_code == 0)
+        {
+            free(jobs);
+            return -1;
+        }
+        next_idx = idx + len_code;
+        if (next_idx > src_len)
+        {
+            free(jobs);
+            return -1;
+        }
+        dst_len += len_code - 1;
+        if (len_code != 0xFF && next_idx < src_len)
+        {
+            dst_len++;
+        }
+        idx = next_idx;
+    }
+    for (k = 0; k < count; k++)
+    {
+        jobs[k].src_end_ptr = (k + 1 < count) ? jobs[k + 1].src_ptr : src_ptr + src_len;
+        jobs[k].is_final = (k + 1 == count);
+    }
+
+    /* Validate and copy the segments */
+    cobs_run_parallel(cobs_decode_job_run, jobs, sizeof(*jobs), count);
+    for (k = 0; k < count; k++)
+    {
+        if (jobs[k].status != COBS_DECODE_OK)
+        {
+            dst_len = -1;
+        }
+    }
+
+    free(jobs);
+    return dst_len;
 }
 
 
@@ -228,30 +699,39 @@ PyDoc_STRVAR(cobs_decode__doc__,
     "is also a byte string.\n"
     "\n"
     "A cobs.DecodeError exception will be raised if the encoded data\n"
-    "is invalid."
+    "is invalid.\n"
+    "\n"
+    "For a large input, threads may be set greater than 1 to split\n"
+    "the input and decode the parts in parallel."
 );
 
 /*
- * This Python C extension function uses arguments method METH_O,
- * meaning the arg parameter contains the single parameter
- * to the function.
+ * This Python C extension function uses arguments method
+ * METH_VARARGS | METH_KEYWORDS, so that the optional threads
+ * parameter can be given by keyword.
  */
 static PyObject*
-cobs_decode(PyObject* module, PyObject* arg)
+cobs_decode(PyObject* module, PyObject* args, PyObject* kwds)
 {
+    static char *           kwlist[] = { "in_bytes", "threads", NULL };
+    PyObject *              arg;
+    Py_ssize_t              threads;
+    Py_ssize_t              num_segments;
     Py_buffer               src_py_buffer;
     const char *            src_ptr;
     Py_ssize_t              src_len;
-    const char *            src_end_ptr;
     char *                  dst_buf_ptr;
     char *                  dst_write_ptr;
-    Py_ssize_t              remaining_bytes;
-    unsigned char           len_code;
-    unsigned char           src_byte;
-    unsigned char           i;
+    Py_ssize_t              dst_len;
+    cobs_decode_status_t    status;
     PyObject *              dst_py_obj_ptr;
 
 
+    threads = 1;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|n:decode", kwlist, &arg, &threads))
+    {
+        return NULL;
+    }
     if (PyUnicode_Check((arg)))
     {
         PyErr_SetString(PyExc_TypeError,
@@ -262,7 +742,12 @@ cobs_decode(PyObject* module, PyObject* arg)
     src_ptr = src_py_buffer.buf;
     src_len = src_py_buffer.len;
 
-    src_end_ptr = src_ptr + src_len;
+    num_segments = cobs_num_segments(threads, src_len);
+    if (num_segments < 0)
+    {
+        PyBuffer_Release(&src_py_buffer);
+        return NULL;
+    }
 
     /* Make an output string */
     dst_py_obj_ptr = PyBytes_FromStringAndSize(NULL, COBS_DECODE_DST_BUF_LEN_MAX(src_len));
@@ -274,64 +759,290 @@ cobs_decode(PyObject* module, PyObject* arg)
     dst_buf_ptr = PyBytes_AsString(dst_py_obj_ptr);
 
     /* Decode */
-    dst_write_ptr = dst_buf_ptr;
+    dst_len = -1;
+    if (num_segments > 1)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        dst_len = cobs_decode_parallel(src_ptr, src_len, dst_buf_ptr, num_segments);
+        Py_END_ALLOW_THREADS
+        if (dst_len == -2)
+        {
+            PyBuffer_Release(&src_py_buffer);
+            Py_DECREF(dst_py_obj_ptr);
+            return PyErr_NoMemory();
+        }
+        /* If the data is invalid, fall through to decode it serially, so the
+         * error reported is the first one in the data. */
+    }
+    if (dst_len < 0)
+    {
+        dst_write_ptr = dst_buf_ptr;
+        status = COBS_DECODE_OK;
+        if (src_len != 0)
+        {
+            status = cobs_decode_run(src_ptr, src_ptr + src_len, &dst_write_ptr, TRUE);
+        }
+        if (status != COBS_DECODE_OK)
+        {
+            PyBuffer_Release(&src_py_buffer);
+            Py_DECREF(dst_py_obj_ptr);
+            PyErr_SetString(GETSTATE(module)->CobsDecodeError,
+                            (status == COBS_DECODE_ZERO_BYTE) ?
+                                "zero byte found in input" :
+                                "not enough input bytes for length code");
+            return NULL;
+        }
+        dst_len = dst_write_ptr - dst_buf_ptr;
+    }
+
+    /* We're done with the input buffer now, so we have to release the PyBuffer. */
+    PyBuffer_Release(&src_py_buffer);
+
+    /* Set the output length */
+    _PyBytes_Resize(&dst_py_obj_ptr, dst_len);
 
-    if (src_len != 0)
+    return dst_py_obj_ptr;
+}
+
+
+/*
+ * cobs.decode_segments
+ */
+PyDoc_STRVAR(cobs_decode_segments__doc__,
+    "Decode a string using Consistent Overhead Byte Stuffing (COBS),\n"
+    "without copying the data.\n"
+    "\n"
+    "Input should be a byte buffer that has been COBS encoded. Output\n"
+    "is a list of segments. Each run of non-zero data bytes is a\n"
+    "memoryview slice of the input buffer. Each zero byte implied by\n"
+    "the encoding is the byte string b'\\x00'. So b''.join() of the\n"
+    "segments gives the same result as decode(), and the list can be\n"
+    "passed directly to socket.sendmsg() or os.writev().\n"
+    "\n"
+    "A cobs.DecodeError exception will be raised if the encoded data\n"
+    "is invalid."
+);
+
+/*
+ * This Python C extension function uses arguments method METH_O,
+ * meaning the arg parameter contains the single parameter
+ * to the function.
+ */
+static PyObject*
+cobs_decode_segments(PyObject* module, PyObject* arg)
+{
+    Py_buffer               src_py_buffer;
+    const unsigned char *   src_ptr;
+    Py_ssize_t              src_len;
+    Py_ssize_t              idx;
+    Py_ssize_t              run_len;
+    unsigned char           len_code;
+    const char *            error_msg;
+    PyObject *              mv_py_obj_ptr;
+    PyObject *              zero_py_obj_ptr;
+    PyObject *              dst_py_obj_ptr;
+
+
+    if (PyUnicode_Check((arg)))
     {
-        for (;;)
+        PyErr_SetString(PyExc_TypeError,
+                        "Unicode-objects are not supported; byte buffer objects only");
+        return NULL;
+    }
+    GET_BUFFER_VIEW_OR_ERROUT(arg, &src_py_buffer);
+    src_ptr = src_py_buffer.buf;
+    src_len = src_py_buffer.len;
+
+    /* Validate, in the same order of checks as cobs_decode_run(), so the
+     * error reported is the same as for decode(). */
+    error_msg = NULL;
+    idx = 0;
+    while (idx < src_len)
+    {
+        len_code = src_ptr[idx++];
+        if (len_code == 0)
         {
-            len_code = (unsigned char) *src_ptr++;
-            if (len_code == 0)
-            {
-                PyBuffer_Release(&src_py_buffer);
-                Py_DECREF(dst_py_obj_ptr);
-                PyErr_SetString(GETSTATE(module)->CobsDecodeError, "zero byte found in input");
-                return NULL;
-            }
-            len_code--;
+            error_msg = "zero byte found in input";
+            break;
+        }
+        run_len = len_code - 1;
+        if (run_len > src_len - idx)
+        {
+            error_msg = "not enough input bytes for length code";
+            break;
+        }
+        if (memchr(src_ptr + idx, 0, run_len) != NULL)
+        {
+            error_msg = "zero byte found in input";
+            break;
+        }
+        idx += run_len;
+    }
+    if (error_msg != NULL)
+    {
+        PyBuffer_Release(&src_py_buffer);
+        PyErr_SetString(GETSTATE(module)->CobsDecodeError, error_msg);
+        return NULL;
+    }
 
-            remaining_bytes = src_end_ptr - src_ptr;
-            if (len_code > remaining_bytes)
-            {
-                PyBuffer_Release(&src_py_buffer);
-                Py_DECREF(dst_py_obj_ptr);
-                PyErr_SetString(GETSTATE(module)->CobsDecodeError, "not enough input bytes for length code");
-                return NULL;
-            }
+    dst_py_obj_ptr = PyList_New(0);
+    mv_py_obj_ptr = cobs_py_byte_memoryview(arg, &src_py_buffer);
+    zero_py_obj_ptr = PyBytes_FromStringAndSize("", 1);
+    if (dst_py_obj_ptr == NULL || mv_py_obj_ptr == NULL || zero_py_obj_ptr == NULL)
+    {
+        goto error;
+    }
 
-            for (i = len_code; i != 0; i--)
+    /* Make the segments */
+    idx = 0;
+    while (idx < src_len)
+    {
+        len_code = src_ptr[idx++];
+        run_len = len_code - 1;
+        if (cobs_py_append_segment(dst_py_obj_ptr, mv_py_obj_ptr, idx, idx + run_len) < 0)
+        {
+            goto error;
+        }
+        idx += run_len;
+        if (idx < src_len && len_code != 0xFF)
+        {
+            if (PyList_Append(dst_py_obj_ptr, zero_py_obj_ptr) < 0)
             {
-                src_byte = *src_ptr++;
-                if (src_byte == 0)
-                {
-                    PyBuffer_Release(&src_py_buffer);
-                    Py_DECREF(dst_py_obj_ptr);
-                    PyErr_SetString(GETSTATE(module)->CobsDecodeError, "zero byte found in input");
-                    return NULL;
-                }
-                *dst_write_ptr++ = src_byte;
+                goto error;
             }
+        }
+    }
+
+    PyBuffer_Release(&src_py_buffer);
+    Py_DECREF(mv_py_obj_ptr);
+    Py_DECREF(zero_py_obj_ptr);
+    return dst_py_obj_ptr;
+
+error:
+    PyBuffer_Release(&src_py_buffer);
+    Py_XDECREF(mv_py_obj_ptr);
+    Py_XDECREF(zero_py_obj_ptr);
+    Py_XDECREF(dst_py_obj_ptr);
+    return NULL;
+}
 
-            if (src_ptr >= src_end_ptr)
-            {
-                break;
-            }
 
-            /* Add a zero to the end */
-            if (len_code != 0xFE)
+/*
+ * cobs.encode_iov
+ */
+PyDoc_STRVAR(cobs_encode_iov__doc__,
+    "Encode a string using Consistent Overhead Byte Stuffing (COBS),\n"
+    "without copying the data.\n"
+    "\n"
+    "Input is any byte buffer. Output is a list of buffers, which\n"
+    "alternate between a byte string of one or more length codes, and\n"
+    "a memoryview slice of the input holding a run of non-zero data\n"
+    "bytes. So b''.join() of the buffers gives the same result as\n"
+    "encode(), and the list can be passed directly to os.writev() or\n"
+    "socket.sendmsg().\n"
+    "\n"
+    "Each zero byte in the input adds a buffer, so for data with many\n"
+    "zeros, encode() is faster."
+);
+
+/*
+ * This Python C extension function uses arguments method METH_O,
+ * meaning the arg parameter contains the single parameter
+ * to the function.
+ */
+static PyObject*
+cobs_encode_iov(PyObject* module, PyObject* arg)
+{
+    Py_buffer               src_py_buffer;
+    const unsigned char *   src_ptr;
+    const unsigned char *   zero_ptr;
+    Py_ssize_t              src_len;
+    Py_ssize_t              idx;
+    Py_ssize_t              run_len;
+    Py_ssize_t              num_codes;
+    unsigned char           len_code;
+    int                     found_zero;
+    int                     is_final;
+    PyObject *              mv_py_obj_ptr;
+    PyObject *              dst_py_obj_ptr;
+
+
+    if (PyUnicode_Check((arg)))
+    {
+        PyErr_SetString(PyExc_TypeError,
+                        "Unicode-objects must be encoded as bytes first");
+        return NULL;
+    }
+    GET_BUFFER_VIEW_OR_ERROUT(arg, &src_py_buffer);
+    src_ptr = src_py_buffer.buf;
+    src_len = src_py_buffer.len;
+
+    dst_py_obj_ptr = PyList_New(0);
+    mv_py_obj_ptr = cobs_py_byte_memoryview(arg, &src_py_buffer);
+    if (dst_py_obj_ptr == NULL || mv_py_obj_ptr == NULL)
+    {
+        goto error;
+    }
+
+    /* Find the runs of non-zero bytes. Length codes for empty runs are
+     * gathered up, to go in one byte string with the next length code. */
+    idx = 0;
+    num_codes = 0;
+    for (;;)
+    {
+        run_len = src_len - idx;
+        if (run_len > 0xFE)
+        {
+            run_len = 0xFE;
+        }
+        zero_ptr = memchr(src_ptr + idx, 0, run_len);
+        found_zero = (zero_ptr != NULL);
+        if (found_zero)
+        {
+            run_len = zero_ptr - (src_ptr + idx);
+        }
+        is_final = (!found_zero && idx + run_len == src_len);
+        len_code = (unsigned char) (run_len + 1);
+        num_codes++;
+        if (run_len != 0)
+        {
+            if (cobs_py_append_codes(dst_py_obj_ptr, num_codes, len_code) < 0 ||
+                cobs_py_append_segment(dst_py_obj_ptr, mv_py_obj_ptr, idx, idx + run_len) < 0)
             {
-                *dst_write_ptr++ = 0;
+                goto error;
             }
+            num_codes = 0;
+        }
+        idx += run_len;
+
+        if (found_zero)
+        {
+            /* Skip the zero byte. A run follows it, even if it's empty. */
+            idx++;
+        }
+        else if (is_final)
+        {
+            /* That was the final run. */
+            break;
+        }
+    }
+    if (num_codes != 0)
+    {
+        if (cobs_py_append_codes(dst_py_obj_ptr, num_codes, len_code) < 0)
+        {
+            goto error;
         }
     }
 
-    /* We're done with the input buffer now, so we have to release the PyBuffer. */
     PyBuffer_Release(&src_py_buffer);
-
-    /* Calculate the output length, from the value of dst_code_write_ptr */
-    _PyBytes_Resize(&dst_py_obj_ptr, dst_write_ptr - dst_buf_ptr);
-
+    Py_DECREF(mv_py_obj_ptr);
     return dst_py_obj_ptr;
+
+error:
+    PyBuffer_Release(&src_py_buffer);
+    Py_XDECREF(mv_py_obj_ptr);
+    Py_XDECREF(dst_py_obj_ptr);
+    return NULL;
 }
 
 
@@ -345,8 +1056,10 @@ PyDoc_STRVAR(module__doc__,
 
 static PyMethodDef methodTable[] =
 {
-    { "encode", cobs_encode, METH_O, cobs_encode__doc__ },
-    { "decode", cobs_decode, METH_O, cobs_decode__doc__ },
+    { "encode", (PyCFunction) cobs_encode, METH_VARARGS | METH_KEYWORDS, cobs_encode__doc__ },
+    { "decode", (PyCFunction) cobs_decode, METH_VARARGS | METH_KEYWORDS, cobs_decode__doc__ },
+    { "encode_iov", cobs_encode_iov, METH_O, cobs_encode_iov__doc__ },
+    { "decode_segments", cobs_decode_segments, METH_O, cobs_decode_segments__doc__ },
     { NULL, NULL, 0, NULL }
 };
 
@@ -32,6 +32,10 @@
 // Force Py_ssize_t to be used for s# conversions.
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <string.h>
+
+#include "cobsr_kernel.h"
+#include "cobs_py_helpers.h"
 
 
 /*****************************************************************************
@@ -61,7 +65,7 @@
                             "object supporting the buffer API is required"); \
             return NULL; \
         } \
-        if (PyObject_GetBuffer((obj), (viewp), PyBUF_FORMAT) == -1) { \
+        if (PyObject_GetBuffer((obj), (viewp), PyBUF_ND | PyBUF_FORMAT) == -1) { \
             return NULL; \
         } \
         if (((viewp)->ndim > 1) || ((viewp)->itemsize > 1)) { \
@@ -73,10 +77,6 @@
     } while(0);
 
 
-#define COBSR_ENCODE_DST_BUF_LEN_MAX(SRC_LEN)           ((SRC_LEN) + ((SRC_LEN)/254u) + 1)
-#define COBSR_DECODE_DST_BUF_LEN_MAX(SRC_LEN)           (((SRC_LEN) <= 1) ? 1 : (SRC_LEN))
-
-
 /*****************************************************************************
  * Types
  ****************************************************************************/
@@ -117,119 +117,141 @@ PyDoc_STRVAR(cobsr_encode__doc__,
     "Encoding guarantees no zero bytes in the output. The output\n"
     "string may be expanded slightly, by a predictable amount.\n"
     "\n"
-    "An empty string is encoded to '\\x01'."
+    "An empty string is encoded to '\\x01'.\n"
+    "\n"
+    "If any of headroom, tailroom or delimiter is given (not None),\n"
+    "the output is a bytearray, even if they are zero or false. It has\n"
+    "headroom zero bytes before the encoded data, then a zero byte\n"
+    "delimiter if delimiter is true, then tailroom zero bytes. Link\n"
+    "layer headers and trailers can then be filled in without copying\n"
+    "the encoded data again."
 );
 
 /*
- * This Python C extension function uses arguments method METH_O,
- * meaning the arg parameter contains the single parameter
- * to the function.
+ * This Python C extension function uses arguments method
+ * METH_VARARGS | METH_KEYWORDS, so that the optional headroom,
+ * tailroom and delimiter parameters can be given by keyword.
  */
 static PyObject*
-cobsr_encode(PyObject* module, PyObject* arg)
+cobsr_encode(PyObject* module, PyObject* args, PyObject* kwds)
 {
+    static char *   kwlist[] = { "in_bytes", "headroom", "tailroom", "delimiter", NULL };
+    PyObject *      arg;
+    PyObject *      headroom_obj;
+    PyObject *      tailroom_obj;
+    PyObject *      delimiter_obj;
+    Py_ssize_t      headroom;
+    Py_ssize_t      tailroom;
+    int             delimiter;
+    int             framed;
+    Py_ssize_t      frame_room;
     Py_buffer       src_py_buffer;
-    const char *    src_ptr;
-    Py_ssize_t      src_len;
-    const char *    src_end_ptr;
     char *          dst_buf_ptr;
-    char *          dst_code_write_ptr;
     char *          dst_write_ptr;
-    unsigned char   src_byte;
-    unsigned char   search_len;
     PyObject *      dst_py_obj_ptr;
 
 
+    headroom_obj = NULL;
+    tailroom_obj = NULL;
+    delimiter_obj = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|$OOO:encode", kwlist,
+                                     &arg, &headroom_obj, &tailroom_obj, &delimiter_obj))
+    {
+        return NULL;
+    }
     if (PyUnicode_Check((arg)))
     {
         PyErr_SetString(PyExc_TypeError,
                         "Unicode-objects must be encoded as bytes first");
         return NULL;
     }
+    framed = cobs_py_frame_args(headroom_obj, tailroom_obj, delimiter_obj, &headroom, &tailroom, &delimiter);
+    if (framed < 0)
+    {
+        return NULL;
+    }
+    frame_room = headroom + tailroom + (delimiter ? 1 : 0);
     GET_BUFFER_VIEW_OR_ERROUT(arg, &src_py_buffer);
-    src_ptr = src_py_buffer.buf;
-    src_len = src_py_buffer.len;
-
-    src_end_ptr = src_ptr + src_len;
 
     /* Make an output string */
-    dst_py_obj_ptr = PyBytes_FromStringAndSize(NULL, COBSR_ENCODE_DST_BUF_LEN_MAX(src_len));
+    dst_py_obj_ptr = cobs_py_encode_output_new(framed, COBSR_ENCODE_DST_BUF_LEN_MAX(src_py_buffer.len), frame_room, &dst_buf_ptr);
     if (dst_py_obj_ptr == NULL)
     {
+        PyBuffer_Release(&src_py_buffer);
         return NULL;
     }
-    dst_buf_ptr = PyBytes_AsString(dst_py_obj_ptr);
+    dst_buf_ptr += headroom;
 
     /* Encode */
-    dst_code_write_ptr  = dst_buf_ptr;
-    dst_write_ptr = dst_code_write_ptr + 1;
-    search_len = 1;
-    src_byte = 0;
+    dst_write_ptr = cobsr_encode_run(src_py_buffer.buf, src_py_buffer.len, dst_buf_ptr);
+
+    /* We're done with the input buffer now, so we have to release the PyBuffer. */
+    PyBuffer_Release(&src_py_buffer);
+
+    /* Calculate the output length, from the value of dst_write_ptr */
+    return cobs_py_encode_output_finish(dst_py_obj_ptr, framed, dst_write_ptr - dst_buf_ptr, headroom, tailroom, delimiter);
+}
+
+/*
+ * cobsr.decode
+ */
+PyDoc_STRVAR(cobsr_decode__doc__,
+    "Decode a string using Consistent Overhead Byte Stuffing/Reduced (COBS/R).\n"
+    "\n"
+    "Input should be a byte string that has been COBS/R encoded. Output\n"
+    "is also a byte string.\n"
+    "\n"
+    "A cobsr.DecodeError exception will be raised if the encoded data\n"
+    "is invalid. That is, if the encoded data contains zeros."
+);
+
+/*
+ * This Python C extension function uses arguments method METH_O,
+ * meaning the arg parameter contains the single parameter
+ * to the function.
+ */
+static PyObject*
+cobsr_decode(PyObject* module, PyObject* arg)
+{
+    Py_buffer               src_py_buffer;
+    char *                  dst_buf_ptr;
+    char *                  dst_write_ptr;
+    cobsr_decode_status_t   status;
+    PyObject *              dst_py_obj_ptr;
+
 
-    /* Iterate over the source bytes */
-    if (src_len != 0)
+    if (PyUnicode_Check((arg)))
     {
-        for (;;)
-        {
-            src_byte = *src_ptr++;
-            if (src_byte == 0)
-            {
-                /* We found a zero byte */
-                *dst_code_write_ptr = (char) search_len;
-                dst_code_write_ptr = dst_write_ptr++;
-                search_len = 1;
-                if (src_ptr >= src_end_ptr)
-                {
-                    break;
-                }
-            }
-            else
-            {
-                /* Copy the non-zero byte to the destination buffer */
-                *dst_write_ptr++ = src_byte;
-                search_len++;
-                if (src_ptr >= src_end_ptr)
-                {
-                    break;
-                }
-                if (search_len == 0xFF)
-                {
-                    /* We have a long string of non-zero bytes */
-                    *dst_code_write_ptr = (char) search_len;
-                    dst_code_write_ptr = dst_write_ptr++;
-                    search_len = 1;
-                }
-            }
-        }
+        PyErr_SetString(PyExc_TypeError,
+                        "Unicode-objects are not supported; byte buffer objects only");
+        return NULL;
     }
+    GET_BUFFER_VIEW_OR_ERROUT(arg, &src_py_buffer);
+
+    /* Make an output string */
+    dst_py_obj_ptr = PyBytes_FromStringAndSize(NULL, COBSR_DECODE_DST_BUF_LEN_MAX(src_py_buffer.len));
+    if (dst_py_obj_ptr == NULL)
+    {
+        PyBuffer_Release(&src_py_buffer);
+        return NULL;
+    }
+    dst_buf_ptr = PyBytes_AsString(dst_py_obj_ptr);
+
+    /* Decode */
+    dst_write_ptr = dst_buf_ptr;
+    status = cobsr_decode_run(src_py_buffer.buf, src_py_buffer.len, &dst_write_ptr);
 
     /* We're done with the input buffer now, so we have to release the PyBuffer. */
     PyBuffer_Release(&src_py_buffer);
 
-    /* We've reached the end of the source data.
-     * Finalise the remaining output. In particular, write the code (length) byte.
-     *
-     * For COBS/R, the final code (length) byte is special: if the final data byte is
-     * greater than or equal to what would normally be the final code (length) byte,
-     * then replace the final code byte with the final data byte, and remove the final
-     * data byte from the end of the sequence. This saves one byte in the output.
-     *
-     * Update the pointer to calculate the final output length.
-     */
-    if (src_byte < search_len)
-    {
-        /* Encoding same as plain COBS */
-        *dst_code_write_ptr = (char) search_len;
-    }
-    else
+    if (status != COBSR_DECODE_OK)
     {
-        /* Special COBS/R encoding: length code is final byte,
-         * and final byte is removed from data sequence. */
-        *dst_code_write_ptr = (char) src_byte;
-        dst_write_ptr--;
+        Py_DECREF(dst_py_obj_ptr);
+        PyErr_SetString(GETSTATE(module)->CobsrDecodeError, "zero byte found in input");
+        return NULL;
     }
 
-    /* Calculate the output length, from the value of dst_code_write_ptr */
+    /* Calculate the output length, from the value of dst_write_ptr */
     _PyBytes_Resize(&dst_py_obj_ptr, dst_write_ptr - dst_buf_ptr);
 
     return dst_py_obj_ptr;
@@ -237,13 +259,20 @@ cobsr_encode(PyObject* module, PyObject* arg)
 
 
 /*
- * cobsr.decode
+ * cobsr.decode_segments
  */
-PyDoc_STRVAR(cobsr_decode__doc__,
-    "Decode a string using Consistent Overhead Byte Stuffing/Reduced (COBS/R).\n"
+PyDoc_STRVAR(cobsr_decode_segments__doc__,
+    "Decode a string using Consistent Overhead Byte Stuffing/Reduced (COBS/R),\n"
+    "without copying the data.\n"
     "\n"
-    "Input should be a byte string that has been COBS/R encoded. Output\n"
-    "is also a byte string.\n"
+    "Input should be a byte buffer that has been COBS/R encoded. Output\n"
+    "is a list of segments. Each run of non-zero data bytes is a\n"
+    "memoryview slice of the input buffer. Each zero byte implied by\n"
+    "the encoding is the byte string b'\\x00'. If the final data byte\n"
+    "was moved into the final length code by the COBS/R encoding, it is\n"
+    "a one-byte memoryview slice of that length code. So b''.join() of\n"
+    "the segments gives the same result as decode(), and the list can be\n"
+    "passed directly to socket.sendmsg() or os.writev().\n"
     "\n"
     "A cobsr.DecodeError exception will be raised if the encoded data\n"
     "is invalid. That is, if the encoded data contains zeros."
@@ -255,18 +284,17 @@ PyDoc_STRVAR(cobsr_decode__doc__,
  * to the function.
  */
 static PyObject*
-cobsr_decode(PyObject* module, PyObject* arg)
+cobsr_decode_segments(PyObject* module, PyObject* arg)
 {
     Py_buffer               src_py_buffer;
-    const char *            src_ptr;
+    const unsigned char *   src_ptr;
     Py_ssize_t              src_len;
-    const char *            src_end_ptr;
-    char *                  dst_buf_ptr;
-    char *                  dst_write_ptr;
-    Py_ssize_t              remaining_bytes;
+    Py_ssize_t              code_idx;
+    Py_ssize_t              idx;
+    Py_ssize_t              run_len;
     unsigned char           len_code;
-    unsigned char           src_byte;
-    unsigned char           i;
+    PyObject *              mv_py_obj_ptr;
+    PyObject *              zero_py_obj_ptr;
     PyObject *              dst_py_obj_ptr;
 
 
@@ -280,93 +308,205 @@ cobsr_decode(PyObject* module, PyObject* arg)
     src_ptr = src_py_buffer.buf;
     src_len = src_py_buffer.len;
 
-    src_end_ptr = src_ptr + src_len;
-
-    /* Make an output string */
-    dst_py_obj_ptr = PyBytes_FromStringAndSize(NULL, COBSR_DECODE_DST_BUF_LEN_MAX(src_len));
-    if (dst_py_obj_ptr == NULL)
+    /* Any zero byte makes COBS/R encoded data invalid. */
+    if (memchr(src_ptr, 0, src_len) != NULL)
     {
         PyBuffer_Release(&src_py_buffer);
+        PyErr_SetString(GETSTATE(module)->CobsrDecodeError, "zero byte found in input");
         return NULL;
     }
-    dst_buf_ptr = PyBytes_AsString(dst_py_obj_ptr);
 
-    /* Decode */
-    dst_write_ptr = dst_buf_ptr;
+    dst_py_obj_ptr = PyList_New(0);
+    mv_py_obj_ptr = cobs_py_byte_memoryview(arg, &src_py_buffer);
+    zero_py_obj_ptr = PyBytes_FromStringAndSize("", 1);
+    if (dst_py_obj_ptr == NULL || mv_py_obj_ptr == NULL || zero_py_obj_ptr == NULL)
+    {
+        goto error;
+    }
 
-    if (src_len != 0)
+    /* Make the segments */
+    idx = 0;
+    while (idx < src_len)
     {
-        for (;;)
+        code_idx = idx++;
+        len_code = src_ptr[code_idx];
+        run_len = len_code - 1;
+        if (run_len < src_len - idx)
         {
-            len_code = (unsigned char) *src_ptr++;
-            if (len_code == 0)
+            if (cobs_py_append_segment(dst_py_obj_ptr, mv_py_obj_ptr, idx, idx + run_len) < 0)
             {
-                PyBuffer_Release(&src_py_buffer);
-                Py_DECREF(dst_py_obj_ptr);
-                PyErr_SetString(GETSTATE(module)->CobsrDecodeError, "zero byte found in input");
-                return NULL;
+                goto error;
             }
-
-            remaining_bytes = src_end_ptr - src_ptr;
-
-            if ((len_code - 1) < remaining_bytes)
+            idx += run_len;
+            if (len_code != 0xFF)
             {
-                for (i = len_code - 1; i != 0; i--)
+                if (PyList_Append(dst_py_obj_ptr, zero_py_obj_ptr) < 0)
                 {
-                    src_byte = *src_ptr++;
-                    if (src_byte == 0)
-                    {
-                        PyBuffer_Release(&src_py_buffer);
-                        Py_DECREF(dst_py_obj_ptr);
-                        PyErr_SetString(GETSTATE(module)->CobsrDecodeError, "zero byte found in input");
-                        return NULL;
-                    }
-                    *dst_write_ptr++ = src_byte;
-                }
-
-                /* Add a zero to the end */
-                if (len_code != 0xFF)
-                {
-                    *dst_write_ptr++ = 0;
+                    goto error;
                 }
             }
-            else
+        }
+        else
+        {
+            /* The last length code. The remaining bytes are data, and then
+             * the length code itself is the final data byte if it is too big
+             * for the number of bytes remaining. */
+            if (cobs_py_append_segment(dst_py_obj_ptr, mv_py_obj_ptr, idx, src_len) < 0)
             {
-                /* We've reached the last length code, so write the remaining
-                 * bytes and then exit the loop. */
-
-                for (i = remaining_bytes; i != 0; i--)
-                {
-                    src_byte = *src_ptr++;
-                    if (src_byte == 0)
-                    {
-                        PyBuffer_Release(&src_py_buffer);
-                        Py_DECREF(dst_py_obj_ptr);
-                        PyErr_SetString(GETSTATE(module)->CobsrDecodeError, "zero byte found in input");
-                        return NULL;
-                    }
-                    *dst_write_ptr++ = src_byte;
-                }
-
-                /* Write final data byte, if applicable for COBS/R encoding. */
-                if (len_code - 1 > remaining_bytes)
+                goto error;
+            }
+            if (run_len > src_len - idx)
+            {
+                if (cobs_py_append_segment(dst_py_obj_ptr, mv_py_obj_ptr, code_idx, code_idx + 1) < 0)
                 {
-                    *dst_write_ptr++ = len_code;
+                    goto error;
                 }
-
-                /* Exit the loop */
-                break;
             }
+            break;
         }
     }
 
-    /* We're done with the input buffer now, so we have to release the PyBuffer. */
     PyBuffer_Release(&src_py_buffer);
+    Py_DECREF(mv_py_obj_ptr);
+    Py_DECREF(zero_py_obj_ptr);
+    return dst_py_obj_ptr;
 
-    /* Calculate the output length, from the value of dst_code_write_ptr */
-    _PyBytes_Resize(&dst_py_obj_ptr, dst_write_ptr - dst_buf_ptr);
+error:
+    PyBuffer_Release(&src_py_buffer);
+    Py_XDECREF(mv_py_obj_ptr);
+    Py_XDECREF(zero_py_obj_ptr);
+    Py_XDECREF(dst_py_obj_ptr);
+    return NULL;
+}
+
+
+/*
+ * cobsr.encode_iov
+ */
+PyDoc_STRVAR(cobsr_encode_iov__doc__,
+    "Encode a string using Consistent Overhead Byte Stuffing/Reduced (COBS/R),\n"
+    "without copying the data.\n"
+    "\n"
+    "Input is any byte buffer. Output is a list of buffers, which\n"
+    "alternate between a byte string of one or more length codes, and\n"
+    "a memoryview slice of the input holding a run of non-zero data\n"
+    "bytes. So b''.join() of the buffers gives the same result as\n"
+    "encode(), and the list can be passed directly to os.writev() or\n"
+    "socket.sendmsg().\n"
+    "If the COBS/R encoding moves the final data byte into the final\n"
+    "length code, the final memoryview slice is one byte shorter.\n"
+    "\n"
+    "Each zero byte in the input adds a buffer, so for data with many\n"
+    "zeros, encode() is faster."
+);
 
+/*
+ * This Python C extension function uses arguments method METH_O,
+ * meaning the arg parameter contains the single parameter
+ * to the function.
+ */
+static PyObject*
+cobsr_encode_iov(PyObject* module, PyObject* arg)
+{
+    Py_buffer               src_py_buffer;
+    const unsigned char *   src_ptr;
+    const unsigned char *   zero_ptr;
+    Py_ssize_t              src_len;
+    Py_ssize_t              idx;
+    Py_ssize_t              run_len;
+    Py_ssize_t              num_codes;
+    unsigned char           len_code;
+    int                     found_zero;
+    int                     is_final;
+    PyObject *              mv_py_obj_ptr;
+    PyObject *              dst_py_obj_ptr;
+
+
+    if (PyUnicode_Check((arg)))
+    {
+        PyErr_SetString(PyExc_TypeError,
+                        "Unicode-objects must be encoded as bytes first");
+        return NULL;
+    }
+    GET_BUFFER_VIEW_OR_ERROUT(arg, &src_py_buffer);
+    src_ptr = src_py_buffer.buf;
+    src_len = src_py_buffer.len;
+
+    dst_py_obj_ptr = PyList_New(0);
+    mv_py_obj_ptr = cobs_py_byte_memoryview(arg, &src_py_buffer);
+    if (dst_py_obj_ptr == NULL || mv_py_obj_ptr == NULL)
+    {
+        goto error;
+    }
+
+    /* Find the runs of non-zero bytes. Length codes for empty runs are
+     * gathered up, to go in one byte string with the next length code. */
+    idx = 0;
+    num_codes = 0;
+    for (;;)
+    {
+        run_len = src_len - idx;
+        if (run_len > 0xFE)
+        {
+            run_len = 0xFE;
+        }
+        zero_ptr = memchr(src_ptr + idx, 0, run_len);
+        found_zero = (zero_ptr != NULL);
+        if (found_zero)
+        {
+            run_len = zero_ptr - (src_ptr + idx);
+        }
+        is_final = (!found_zero && idx + run_len == src_len);
+        len_code = (unsigned char) (run_len + 1);
+
+        /* COBS/R: if the final data byte is at least the final length code,
+         * it replaces the length code, and is left out of the data. */
+        if (is_final && run_len != 0 &&
+            src_ptr[idx + run_len - 1] >= len_code)
+        {
+            len_code = src_ptr[idx + run_len - 1];
+            run_len--;
+        }
+        num_codes++;
+        if (run_len != 0)
+        {
+            if (cobs_py_append_codes(dst_py_obj_ptr, num_codes, len_code) < 0 ||
+                cobs_py_append_segment(dst_py_obj_ptr, mv_py_obj_ptr, idx, idx + run_len) < 0)
+            {
+                goto error;
+            }
+            num_codes = 0;
+        }
+        idx += run_len;
+
+        if (found_zero)
+        {
+            /* Skip the zero byte. A run follows it, even if it's empty. */
+            idx++;
+        }
+        else if (is_final)
+        {
+            /* That was the final run. */
+            break;
+        }
+    }
+    if (num_codes != 0)
+    {
+        if (cobs_py_append_codes(dst_py_obj_ptr, num_codes, len_code) < 0)
+        {
+            goto error;
+        }
+    }
+
+    PyBuffer_Release(&src_py_buffer);
+    Py_DECREF(mv_py_obj_ptr);
     return dst_py_obj_ptr;
+
+error:
+    PyBuffer_Release(&src_py_buffer);
+    Py_XDECREF(mv_py_obj_ptr);
+    Py_XDECREF(dst_py_obj_ptr);
+    return NULL;
 }
 
 
@@ -380,8 +520,10 @@ PyDoc_STRVAR(module__doc__,
 
 static PyMethodDef methodTable[] =
 {
-    { "encode", cobsr_encode, METH_O, cobsr_encode__doc__ },
+    { "encode", (PyCFunction) cobsr_encode, METH_VARARGS | METH_KEYWORDS, cobsr_encode__doc__ },
     { "decode", cobsr_decode, METH_O, cobsr_decode__doc__ },
+    { "encode_iov", cobsr_encode_iov, METH_O, cobsr_encode_iov__doc__ },
+    { "decode_segments", cobsr_decode_segments, METH_O, cobsr_decode_segments__doc__ },
     { NULL, NULL, 0, NULL }
 };
 
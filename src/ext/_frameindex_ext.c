@@ -0,0 +1,282 @@
+/*
+ * Consistent Overhead Byte Stuffing (COBS) frame index
+ *
+ * Python C extension for indexing the frames in COBS framed data.
+ *
+ * Copyright (c) 2010 Craig McQueen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*****************************************************************************
+ * Includes
+ ****************************************************************************/
+
+// Force Py_ssize_t to be used for s# conversions.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <stdint.h>
+#include <string.h>
+
+
+/*****************************************************************************
+ * Defines
+ ****************************************************************************/
+
+/*
+ * Given a PyObject* obj, fill in the Py_buffer* viewp with the result
+ * of PyObject_GetBuffer.  Sets and exception and issues a return NULL
+ * on any errors.
+ */
+#define GET_BUFFER_VIEW_OR_ERROUT(obj, viewp) do { \
+        if (!PyObject_CheckBuffer((obj))) { \
+            PyErr_SetString(PyExc_TypeError, \
+                            "object supporting the buffer API is required"); \
+            return NULL; \
+        } \
+        if (PyObject_GetBuffer((obj), (viewp), PyBUF_ND | PyBUF_FORMAT) == -1) { \
+            return NULL; \
+        } \
+        if (((viewp)->ndim > 1) || ((viewp)->itemsize > 1)) { \
+            PyErr_SetString(PyExc_BufferError, \
+                            "object must be a single-dimension buffer of bytes"); \
+            PyBuffer_Release((viewp)); \
+            return NULL; \
+        } \
+    } while(0);
+
+
+/* Number of frames found per chunk of the scan. Each chunk is appended to
+ * the output arrays before the scan continues, so the index is held only
+ * once in memory, plus this much. */
+#define FRAME_INDEX_CHUNK_FRAMES                        (64 * 1024)
+
+
+/*****************************************************************************
+ * Types
+ ****************************************************************************/
+
+struct frame_index_chunk
+{
+    int64_t         offsets[FRAME_INDEX_CHUNK_FRAMES];
+    int64_t         lengths[FRAME_INDEX_CHUNK_FRAMES];
+    Py_ssize_t      count;
+};
+
+
+/*****************************************************************************
+ * Functions
+ ****************************************************************************/
+
+/*
+ * Find the frames in src_len bytes at src_ptr, starting from offset *pos_ptr.
+ * A frame is any non-empty run of non-zero bytes; zero bytes are the frame
+ * delimiters.
+ *
+ * The scan stops when the chunk is full, or at the end of the data. *pos_ptr
+ * is updated to the offset to continue from.
+ *
+ * The delimiter search uses memchr(), which the C library implements with
+ * vector instructions, so this runs at close to memory bandwidth for typical
+ * frame sizes.
+ *
+ * This doesn't touch any Python objects, so it is called with the GIL released.
+ */
+static void
+frame_index_scan(const char * src_ptr, Py_ssize_t src_len, Py_ssize_t * pos_ptr, struct frame_index_chunk * chunk)
+{
+    Py_ssize_t      pos;
+    Py_ssize_t      end;
+    const char *    zero_ptr;
+
+
+    pos = *pos_ptr;
+    chunk->count = 0;
+    while (pos < src_len && chunk->count < FRAME_INDEX_CHUNK_FRAMES)
+    {
+        zero_ptr = memchr(src_ptr + pos, 0, src_len - pos);
+        end = (zero_ptr != NULL) ? (zero_ptr - src_ptr) : src_len;
+        if (end > pos)
+        {
+            chunk->offsets[chunk->count] = pos;
+            chunk->lengths[chunk->count] = end - pos;
+            chunk->count++;
+        }
+        pos = end + 1;
+    }
+    *pos_ptr = pos;
+}
+
+
+/*
+ * Append count int64_t values at values_ptr to the array('q') array_py_obj_ptr.
+ * Returns 0 on success, or -1 with an exception set.
+ */
+static int
+frame_index_array_extend(PyObject * array_py_obj_ptr, int64_t * values_ptr, Py_ssize_t count)
+{
+    PyObject *      mv_py_obj_ptr;
+    PyObject *      result_py_obj_ptr;
+
+
+    mv_py_obj_ptr = PyMemoryView_FromMemory((char *) values_ptr, count * sizeof(int64_t), PyBUF_READ);
+    if (mv_py_obj_ptr == NULL)
+    {
+        return -1;
+    }
+    result_py_obj_ptr = PyObject_CallMethod(array_py_obj_ptr, "frombytes", "O", mv_py_obj_ptr);
+    Py_DECREF(mv_py_obj_ptr);
+    if (result_py_obj_ptr == NULL)
+    {
+        return -1;
+    }
+    Py_DECREF(result_py_obj_ptr);
+    return 0;
+}
+
+
+/*
+ * frameindex.scan_frames
+ */
+PyDoc_STRVAR(frameindex_scan_frames__doc__,
+    "Find the frames in a buffer of COBS framed data.\n"
+    "\n"
+    "A frame is any non-empty run of non-zero bytes; zero bytes are\n"
+    "the frame delimiters.\n"
+    "\n"
+    "Returns a tuple (offsets, lengths) of array('q') objects, giving\n"
+    "the byte offset and length of each frame."
+);
+
+/*
+ * This Python C extension function uses arguments method METH_O,
+ * meaning the arg parameter contains the single parameter
+ * to the function.
+ */
+static PyObject*
+frameindex_scan_frames(PyObject* module, PyObject* arg)
+{
+    Py_buffer                   src_py_buffer;
+    struct frame_index_chunk *  chunk;
+    Py_ssize_t                  pos;
+    PyObject *                  array_module_py_obj_ptr;
+    PyObject *                  offsets_py_obj_ptr;
+    PyObject *                  lengths_py_obj_ptr;
+
+
+    if (PyUnicode_Check((arg)))
+    {
+        PyErr_SetString(PyExc_TypeError,
+                        "Unicode-objects are not supported; byte buffer objects only");
+        return NULL;
+    }
+    GET_BUFFER_VIEW_OR_ERROUT(arg, &src_py_buffer);
+
+    /* Make the output arrays */
+    offsets_py_obj_ptr = NULL;
+    lengths_py_obj_ptr = NULL;
+    chunk = PyMem_Malloc(sizeof(*chunk));
+    if (chunk == NULL)
+    {
+        PyErr_NoMemory();
+        goto error;
+    }
+    array_module_py_obj_ptr = PyImport_ImportModule("array");
+    if (array_module_py_obj_ptr == NULL)
+    {
+        goto error;
+    }
+    offsets_py_obj_ptr = PyObject_CallMethod(array_module_py_obj_ptr, "array", "s", "q");
+    lengths_py_obj_ptr = PyObject_CallMethod(array_module_py_obj_ptr, "array", "s", "q");
+    Py_DECREF(array_module_py_obj_ptr);
+    if (offsets_py_obj_ptr == NULL || lengths_py_obj_ptr == NULL)
+    {
+        goto error;
+    }
+
+    /* Scan a chunk at a time, appending each chunk to the output arrays. */
+    pos = 0;
+    while (pos < src_py_buffer.len)
+    {
+        Py_BEGIN_ALLOW_THREADS
+        frame_index_scan(src_py_buffer.buf, src_py_buffer.len, &pos, chunk);
+        Py_END_ALLOW_THREADS
+
+        if (frame_index_array_extend(offsets_py_obj_ptr, chunk->offsets, chunk->count) != 0 ||
+            frame_index_array_extend(lengths_py_obj_ptr, chunk->lengths, chunk->count) != 0)
+        {
+            goto error;
+        }
+    }
+
+    /* We're done with the input buffer now, so we have to release the PyBuffer. */
+    PyBuffer_Release(&src_py_buffer);
+    PyMem_Free(chunk);
+
+    return Py_BuildValue("(NN)", offsets_py_obj_ptr, lengths_py_obj_ptr);
+
+error:
+    PyBuffer_Release(&src_py_buffer);
+    PyMem_Free(chunk);
+    Py_XDECREF(offsets_py_obj_ptr);
+    Py_XDECREF(lengths_py_obj_ptr);
+    return NULL;
+}
+
+
+/*****************************************************************************
+ * Module definitions
+ ****************************************************************************/
+
+PyDoc_STRVAR(module__doc__,
+    "Consistent Overhead Byte Stuffing (COBS) frame index"
+);
+
+static PyMethodDef methodTable[] =
+{
+    { "scan_frames", frameindex_scan_frames, METH_O, frameindex_scan_frames__doc__ },
+    { NULL, NULL, 0, NULL }
+};
+
+
+static struct PyModuleDef moduleDef =
+{
+    PyModuleDef_HEAD_INIT,
+    "_frameindex_ext",              // name of module
+    module__doc__,                  // module documentation
+    0,                              // size of per-interpreter state of the module
+    methodTable,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+
+/*****************************************************************************
+ * Module initialisation
+ ****************************************************************************/
+
+PyMODINIT_FUNC
+PyInit__frameindex_ext(void)
+{
+    /* Initialise frameindex module C extension cobs.frameindex._frameindex_ext */
+    return PyModule_Create(&moduleDef);
+}
@@ -0,0 +1,916 @@
+/*
+ * Consistent Overhead Byte Stuffing (COBS) frame streams
+ *
+ * Python C extension for reading and writing COBS frames on file descriptors.
+ *
+ * Copyright (c) 2010 Craig McQueen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*****************************************************************************
+ * Includes
+ ****************************************************************************/
+
+// Force Py_ssize_t to be used for s# conversions.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "cobs_kernel.h"
+#include "cobsr_kernel.h"
+
+
+/*****************************************************************************
+ * Defines
+ ****************************************************************************/
+
+#ifndef FALSE
+#define FALSE       (0)
+#endif
+
+#ifndef TRUE
+#define TRUE        (!FALSE)
+#endif
+
+
+/*
+ * Given a PyObject* obj, fill in the Py_buffer* viewp with the result
+ * of PyObject_GetBuffer.  Sets and exception and issues a return NULL
+ * on any errors.
+ */
+#define GET_BUFFER_VIEW_OR_ERROUT(obj, viewp) do { \
+        if (!PyObject_CheckBuffer((obj))) { \
+            PyErr_SetString(PyExc_TypeError, \
+                            "object supporting the buffer API is required"); \
+            return NULL; \
+        } \
+        if (PyObject_GetBuffer((obj), (viewp), PyBUF_ND | PyBUF_FORMAT) == -1) { \
+            return NULL; \
+        } \
+        if (((viewp)->ndim > 1) || ((viewp)->itemsize > 1)) { \
+            PyErr_SetString(PyExc_BufferError, \
+                            "object must be a single-dimension buffer of bytes"); \
+            PyBuffer_Release((viewp)); \
+            return NULL; \
+        } \
+    } while(0);
+
+
+#define FRAMESTREAM_DEFAULT_BUFSIZE                     (65536)
+
+/* Maximum number of buffers passed to one writev() call */
+#if defined(IOV_MAX) && (IOV_MAX < 256)
+#define FRAMESTREAM_IOV_MAX                             (IOV_MAX)
+#else
+#define FRAMESTREAM_IOV_MAX                             (256)
+#endif
+
+
+/*****************************************************************************
+ * Types
+ ****************************************************************************/
+
+typedef enum
+{
+    FRAMESTREAM_CODEC_COBS = 0,
+    FRAMESTREAM_CODEC_COBSR,
+} framestream_codec_t;
+
+
+typedef struct
+{
+    PyObject_HEAD
+    int                 fd;
+    framestream_codec_t codec;
+    /* DecodeError exception class of the codec module */
+    PyObject *          decode_error;
+    /* Read buffer, of bufsize bytes plus one spare byte. Unread data is
+     * moved to the start with memmove() when the buffer fills up. The spare
+     * byte is read only to find the delimiter of a frame of exactly bufsize
+     * bytes. COBS/R decoding of an unterminated final frame can also write
+     * one byte past the frame. */
+    char *              buf;
+    Py_ssize_t          bufsize;
+    /* Buffered data not yet returned is buf[start:end]. There is no frame
+     * delimiter in buf[start:scan]. */
+    Py_ssize_t          start;
+    Py_ssize_t          scan;
+    Py_ssize_t          end;
+    /* TRUE while skipping the rest of a frame too long for the buffer */
+    int                 discarding;
+    int                 eof;
+    /* TRUE while a read is in progress with the GIL released */
+    int                 busy;
+} FrameReaderObject;
+
+
+typedef struct
+{
+    PyObject_HEAD
+    int                 fd;
+    framestream_codec_t codec;
+    /* Encoded frames (bytes, each including its delimiter) not yet written */
+    PyObject *          pending;
+    /* Number of bytes of the first pending frame already written */
+    Py_ssize_t          pending_offset;
+    Py_ssize_t          pending_bytes;
+    Py_ssize_t          bufsize;
+    /* TRUE while a write is in progress with the GIL released */
+    int                 busy;
+} FrameWriterObject;
+
+
+/*****************************************************************************
+ * Functions
+ ****************************************************************************/
+
+/*
+ * Look up the codec from a codec module (cobs.cobs or cobs.cobsr), or None
+ * for cobs.cobs. Optionally also get its DecodeError class.
+ * Returns 0 on success, or -1 with an exception set.
+ */
+static int
+framestream_get_codec(PyObject * codec_module, framestream_codec_t * codec_ptr, PyObject ** decode_error_ptr)
+{
+    PyObject *      name;
+    int             is_cobs;
+    int             is_cobsr;
+
+
+    if (codec_module == NULL || codec_module == Py_None)
+    {
+        codec_module = PyImport_ImportModule("cobs.cobs");
+        if (codec_module == NULL)
+        {
+            return -1;
+        }
+    }
+    else
+    {
+        Py_INCREF(codec_module);
+    }
+
+    name = PyObject_GetAttrString(codec_module, "__name__");
+    if (name == NULL)
+    {
+        Py_DECREF(codec_module);
+        return -1;
+    }
+    is_cobs = PyUnicode_Check(name) && (PyUnicode_CompareWithASCIIString(name, "cobs.cobs") == 0);
+    is_cobsr = PyUnicode_Check(name) && (PyUnicode_CompareWithASCIIString(name, "cobs.cobsr") == 0);
+    Py_DECREF(name);
+    if (!is_cobs && !is_cobsr)
+    {
+        Py_DECREF(codec_module);
+        PyErr_SetString(PyExc_ValueError, "codec must be the cobs.cobs or cobs.cobsr module");
+        return -1;
+    }
+    *codec_ptr = is_cobsr ? FRAMESTREAM_CODEC_COBSR : FRAMESTREAM_CODEC_COBS;
+
+    if (decode_error_ptr != NULL)
+    {
+        *decode_error_ptr = PyObject_GetAttrString(codec_module, "DecodeError");
+        if (*decode_error_ptr == NULL)
+        {
+            Py_DECREF(codec_module);
+            return -1;
+        }
+    }
+    Py_DECREF(codec_module);
+    return 0;
+}
+
+
+/*****************************************************************************
+ * FrameReader type
+ ****************************************************************************/
+
+PyDoc_STRVAR(FrameReader__doc__,
+    "FrameReader(fd, bufsize=65536, codec=cobs.cobs)\n"
+    "\n"
+    "Read and decode zero-delimited COBS frames from a file descriptor.\n"
+    "\n"
+    "Data is read directly into an internal buffer with the GIL released,\n"
+    "and each complete frame is decoded in place in the buffer. Iterating\n"
+    "yields decoded frames until end of file.\n"
+    "\n"
+    "A frame longer than bufsize is discarded, and the codec's DecodeError\n"
+    "is raised."
+);
+
+static int
+FrameReader_init(FrameReaderObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *   kwlist[] = { "fd", "bufsize", "codec", NULL };
+    int             fd;
+    Py_ssize_t      bufsize;
+    PyObject *      codec_module;
+    PyObject *      decode_error;
+    char *          buf;
+
+
+    bufsize = FRAMESTREAM_DEFAULT_BUFSIZE;
+    codec_module = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i|nO:FrameReader", kwlist, &fd, &bufsize, &codec_module))
+    {
+        return -1;
+    }
+    if (bufsize < 1)
+    {
+        PyErr_SetString(PyExc_ValueError, "bufsize must be at least 1");
+        return -1;
+    }
+    if (self->busy)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "FrameReader is in use by another thread");
+        return -1;
+    }
+    if (framestream_get_codec(codec_module, &self->codec, &decode_error) != 0)
+    {
+        return -1;
+    }
+    buf = PyMem_Malloc(bufsize + 1);
+    if (buf == NULL)
+    {
+        Py_DECREF(decode_error);
+        PyErr_NoMemory();
+        return -1;
+    }
+
+    PyMem_Free(self->buf);
+    Py_XSETREF(self->decode_error, decode_error);
+    self->fd = fd;
+    self->buf = buf;
+    self->bufsize = bufsize;
+    self->start = 0;
+    self->scan = 0;
+    self->end = 0;
+    self->discarding = FALSE;
+    self->eof = FALSE;
+    return 0;
+}
+
+
+static void
+FrameReader_dealloc(FrameReaderObject * self)
+{
+    PyMem_Free(self->buf);
+    Py_XDECREF(self->decode_error);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+
+/*
+ * Decode the frame buf[frame_start:frame_end] in place, and return it as
+ * a bytes object. The kernels only ever write to bytes they have already
+ * read, so decoding in place is safe.
+ */
+static PyObject *
+FrameReader_decode(FrameReaderObject * self, Py_ssize_t frame_start, Py_ssize_t frame_end)
+{
+    const char *    src_ptr;
+    char *          dst_write_ptr;
+    int             status;
+
+
+    src_ptr = self->buf + frame_start;
+    dst_write_ptr = self->buf + frame_start;
+    if (self->codec == FRAMESTREAM_CODEC_COBSR)
+    {
+        status = (cobsr_decode_run(src_ptr, frame_end - frame_start, &dst_write_ptr) == COBSR_DECODE_OK) ?
+                    COBS_DECODE_OK : COBS_DECODE_ZERO_BYTE;
+    }
+    else
+    {
+        status = cobs_decode_run(src_ptr, self->buf + frame_end, &dst_write_ptr, TRUE);
+    }
+
+    if (status != COBS_DECODE_OK)
+    {
+        /* A frame can't contain a zero byte, so this must be a bad length code */
+        PyErr_SetString(self->decode_error, "not enough input bytes for length code");
+        return NULL;
+    }
+    return PyBytes_FromStringAndSize(self->buf + frame_start, dst_write_ptr - (self->buf + frame_start));
+}
+
+
+/*
+ * Return the next decoded frame, or NULL with no exception set at end of file.
+ */
+static PyObject *
+FrameReader_next_frame(FrameReaderObject * self)
+{
+    const char *    zero_ptr;
+    Py_ssize_t      frame_start;
+    Py_ssize_t      frame_end;
+    Py_ssize_t      read_size;
+    Py_ssize_t      read_len;
+    int             read_errno;
+
+
+    if (self->buf == NULL)
+    {
+        PyErr_SetString(PyExc_ValueError, "FrameReader is not initialised");
+        return NULL;
+    }
+    if (self->busy)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "FrameReader is in use by another thread");
+        return NULL;
+    }
+
+    for (;;)
+    {
+        /* Look for a complete frame in the buffered data */
+        while (self->scan < self->end)
+        {
+            zero_ptr = memchr(self->buf + self->scan, 0, self->end - self->scan);
+            if (zero_ptr == NULL)
+            {
+                self->scan = self->end;
+                break;
+            }
+            frame_start = self->start;
+            frame_end = zero_ptr - self->buf;
+            self->start = frame_end + 1;
+            self->scan = self->start;
+            if (self->discarding)
+            {
+                /* End of a frame that was too long */
+                self->discarding = FALSE;
+                continue;
+            }
+            if (frame_end > frame_start)
+            {
+                return FrameReader_decode(self, frame_start, frame_end);
+            }
+        }
+
+        if (self->eof)
+        {
+            /* Treat unterminated data at end of file as a final frame */
+            frame_start = self->start;
+            frame_end = self->end;
+            self->start = self->scan = self->end = 0;
+            if (frame_end > frame_start && !self->discarding)
+            {
+                return FrameReader_decode(self, frame_start, frame_end);
+            }
+            self->discarding = FALSE;
+            return NULL;
+        }
+
+        /* Make room to read more data. While discarding a frame that is too
+         * long, all the buffered data is part of that frame. */
+        if (self->discarding || self->start == self->end)
+        {
+            self->start = self->scan = self->end = 0;
+        }
+        else if (self->end >= self->bufsize)
+        {
+            if (self->end > self->bufsize)
+            {
+                /* The spare byte isn't a delimiter either, so the frame
+                 * doesn't fit in the buffer. Skip it. */
+                self->start = self->scan = self->end = 0;
+                self->discarding = TRUE;
+                PyErr_SetString(self->decode_error, "frame too long for buffer");
+                return NULL;
+            }
+            if (self->start != 0)
+            {
+                memmove(self->buf, self->buf + self->start, self->end - self->start);
+                self->scan -= self->start;
+                self->end -= self->start;
+                self->start = 0;
+            }
+        }
+        /* If a frame fills the buffer, read just the spare byte, to see if it
+         * is the delimiter. */
+        read_size = (self->end < self->bufsize) ? (self->bufsize - self->end) : 1;
+
+        /* Read more data directly into the buffer */
+        self->busy = TRUE;
+        Py_BEGIN_ALLOW_THREADS
+        read_len = read(self->fd, self->buf + self->end, read_size);
+        read_errno = errno;
+        Py_END_ALLOW_THREADS
+        self->busy = FALSE;
+        if (read_len < 0)
+        {
+            if (read_errno == EINTR)
+            {
+                if (PyErr_CheckSignals() != 0)
+                {
+                    return NULL;
+                }
+                continue;
+            }
+            errno = read_errno;
+            return PyErr_SetFromErrno(PyExc_OSError);
+        }
+        if (read_len == 0)
+        {
+            self->eof = TRUE;
+        }
+        self->end += read_len;
+    }
+}
+
+
+PyDoc_STRVAR(FrameReader_read_frame__doc__,
+    "read_frame()\n"
+    "\n"
+    "Return the next decoded frame, reading from the file descriptor\n"
+    "as needed. Returns None at end of file."
+);
+
+static PyObject *
+FrameReader_read_frame(FrameReaderObject * self, PyObject * Py_UNUSED(ignored))
+{
+    PyObject *      frame;
+
+
+    frame = FrameReader_next_frame(self);
+    if (frame == NULL && !PyErr_Occurred())
+    {
+        Py_RETURN_NONE;
+    }
+    return frame;
+}
+
+
+static PyObject *
+FrameReader_iternext(FrameReaderObject * self)
+{
+    return FrameReader_next_frame(self);
+}
+
+
+PyDoc_STRVAR(FrameReader_fileno__doc__,
+    "fileno()\n"
+    "\n"
+    "Return the file descriptor."
+);
+
+static PyObject *
+FrameReader_fileno(FrameReaderObject * self, PyObject * Py_UNUSED(ignored))
+{
+    return PyLong_FromLong(self->fd);
+}
+
+
+static PyMethodDef FrameReader_methods[] =
+{
+    { "read_frame", (PyCFunction) FrameReader_read_frame, METH_NOARGS, FrameReader_read_frame__doc__ },
+    { "fileno", (PyCFunction) FrameReader_fileno, METH_NOARGS, FrameReader_fileno__doc__ },
+    { NULL, NULL, 0, NULL }
+};
+
+
+static PyTypeObject FrameReaderType =
+{
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "cobs.framestream.FrameReader",
+    .tp_basicsize = sizeof(FrameReaderObject),
+    .tp_dealloc = (destructor) FrameReader_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = FrameReader__doc__,
+    .tp_iter = PyObject_SelfIter,
+    .tp_iternext = (iternextfunc) FrameReader_iternext,
+    .tp_methods = FrameReader_methods,
+    .tp_init = (initproc) FrameReader_init,
+    .tp_new = PyType_GenericNew,
+};
+
+
+/*****************************************************************************
+ * FrameWriter type
+ ****************************************************************************/
+
+PyDoc_STRVAR(FrameWriter__doc__,
+    "FrameWriter(fd, bufsize=65536, codec=cobs.cobs)\n"
+    "\n"
+    "Encode and write zero-delimited COBS frames to a file descriptor.\n"
+    "\n"
+    "Encoded frames are held until at least bufsize bytes are pending,\n"
+    "or flush() is called, and then written with writev() with the GIL\n"
+    "released. Using the writer as a context manager flushes it on exit.\n"
+    "The file descriptor is never closed by the writer."
+);
+
+static int
+FrameWriter_init(FrameWriterObject * self, PyObject * args, PyObject * kwds)
+{
+    static char *   kwlist[] = { "fd", "bufsize", "codec", NULL };
+    int             fd;
+    Py_ssize_t      bufsize;
+    PyObject *      codec_module;
+    PyObject *      pending;
+
+
+    bufsize = FRAMESTREAM_DEFAULT_BUFSIZE;
+    codec_module = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i|nO:FrameWriter", kwlist, &fd, &bufsize, &codec_module))
+    {
+        return -1;
+    }
+    if (bufsize < 1)
+    {
+        PyErr_SetString(PyExc_ValueError, "bufsize must be at least 1");
+        return -1;
+    }
+    if (self->busy)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "FrameWriter is in use by another thread");
+        return -1;
+    }
+    if (framestream_get_codec(codec_module, &self->codec, NULL) != 0)
+    {
+        return -1;
+    }
+    pending = PyList_New(0);
+    if (pending == NULL)
+    {
+        return -1;
+    }
+
+    Py_XSETREF(self->pending, pending);
+    self->fd = fd;
+    self->bufsize = bufsize;
+    self->pending_offset = 0;
+    self->pending_bytes = 0;
+    return 0;
+}
+
+
+static void
+FrameWriter_dealloc(FrameWriterObject * self)
+{
+    Py_XDECREF(self->pending);
+    Py_TYPE(self)->tp_free((PyObject *) self);
+}
+
+
+/*
+ * Write as much of the pending data as possible.
+ * Returns 0 on success, or -1 with an exception set.
+ */
+static int
+FrameWriter_write_pending(FrameWriterObject * self)
+{
+    struct iovec    iov[FRAMESTREAM_IOV_MAX];
+    Py_ssize_t      num_pending;
+    Py_ssize_t      written_frames;
+    Py_ssize_t      num_iov;
+    Py_ssize_t      frame_len;
+    Py_ssize_t      offset;
+    Py_ssize_t      write_len;
+    Py_ssize_t      k;
+    PyObject *      frame;
+    int             write_errno;
+    int             result;
+
+
+    if (self->pending == NULL)
+    {
+        PyErr_SetString(PyExc_ValueError, "FrameWriter is not initialised");
+        return -1;
+    }
+    if (self->busy)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "FrameWriter is in use by another thread");
+        return -1;
+    }
+
+    result = 0;
+    num_pending = PyList_GET_SIZE(self->pending);
+    written_frames = 0;
+    offset = self->pending_offset;
+    while (written_frames < num_pending)
+    {
+        /* Gather the pending frames. They can't be changed while the GIL is
+         * released, because the busy flag stops other calls. */
+        num_iov = num_pending - written_frames;
+        if (num_iov > FRAMESTREAM_IOV_MAX)
+        {
+            num_iov = FRAMESTREAM_IOV_MAX;
+        }
+        for (k = 0; k < num_iov; k++)
+        {
+            frame = PyList_GET_ITEM(self->pending, written_frames + k);
+            iov[k].iov_base = PyBytes_AS_STRING(frame) + ((k == 0) ? offset : 0);
+            iov[k].iov_len = PyBytes_GET_SIZE(frame) - ((k == 0) ? offset : 0);
+        }
+
+        self->busy = TRUE;
+        Py_BEGIN_ALLOW_THREADS
+        write_len = writev(self->fd, iov, (int) num_iov);
+        write_errno = errno;
+        Py_END_ALLOW_THREADS
+        self->busy = FALSE;
+
+        if (write_len < 0)
+        {
+            if (write_errno == EINTR)
+            {
+                if (PyErr_CheckSignals() != 0)
+                {
+                    result = -1;
+                    break;
+                }
+                continue;
+            }
+            errno = write_errno;
+            PyErr_SetFromErrno(PyExc_OSError);
+            result = -1;
+            break;
+        }
+
+        /* Account for what was written, which may be a partial write */
+        self->pending_bytes -= write_len;
+        while (write_len > 0)
+        {
+            frame_len = PyBytes_GET_SIZE(PyList_GET_ITEM(self->pending, written_frames));
+            if (write_len >= frame_len - offset)
+            {
+                write_len -= frame_len - offset;
+                offset = 0;
+                written_frames++;
+            }
+            else
+            {
+                offset += write_len;
+                write_len = 0;
+            }
+        }
+    }
+
+    /* Drop the frames that have been written */
+    self->pending_offset = offset;
+    if (PyList_SetSlice(self->pending, 0, written_frames, NULL) != 0)
+    {
+        result = -1;
+    }
+    return result;
+}
+
+
+PyDoc_STRVAR(FrameWriter_write__doc__,
+    "write(data)\n"
+    "\n"
+    "Encode data as one frame, followed by a zero byte delimiter, and\n"
+    "queue it for writing. Pending frames are written once at least\n"
+    "bufsize bytes are pending.\n"
+    "\n"
+    "Once the frame is queued, write() doesn't raise BlockingIOError. If\n"
+    "a non-blocking file descriptor isn't ready, the data stays pending\n"
+    "for the next write() or flush()."
+);
+
+static PyObject *
+FrameWriter_write(FrameWriterObject * self, PyObject * arg)
+{
+    Py_buffer       src_py_buffer;
+    char *          dst_buf_ptr;
+    char *          dst_write_ptr;
+    PyObject *      dst_py_obj_ptr;
+    int             result;
+
+
+    if (self->pending == NULL)
+    {
+        PyErr_SetString(PyExc_ValueError, "FrameWriter is not initialised");
+        return NULL;
+    }
+    if (self->busy)
+    {
+        PyErr_SetString(PyExc_RuntimeError, "FrameWriter is in use by another thread");
+        return NULL;
+    }
+    if (PyUnicode_Check((arg)))
+    {
+        PyErr_SetString(PyExc_TypeError,
+                        "Unicode-objects must be encoded as bytes first");
+        return NULL;
+    }
+    GET_BUFFER_VIEW_OR_ERROUT(arg, &src_py_buffer);
+
+    /* Make an output string, with room for the delimiter */
+    dst_py_obj_ptr = PyBytes_FromStringAndSize(NULL, COBS_ENCODE_DST_BUF_LEN_MAX(src_py_buffer.len) + 1);
+    if (dst_py_obj_ptr == NULL)
+    {
+        PyBuffer_Release(&src_py_buffer);
+        return NULL;
+    }
+    dst_buf_ptr = PyBytes_AsString(dst_py_obj_ptr);
+
+    /* Encode */
+    if (self->codec == FRAMESTREAM_CODEC_COBSR)
+    {
+        dst_write_ptr = cobsr_encode_run(src_py_buffer.buf, src_py_buffer.len, dst_buf_ptr);
+    }
+    else
+    {
+        dst_write_ptr = cobs_encode_run(src_py_buffer.buf, src_py_buffer.len, dst_buf_ptr);
+    }
+    *dst_write_ptr++ = 0;
+
+    /* We're done with the input buffer now, so we have to release the PyBuffer. */
+    PyBuffer_Release(&src_py_buffer);
+
+    if (_PyBytes_Resize(&dst_py_obj_ptr, dst_write_ptr - dst_buf_ptr) != 0)
+    {
+        return NULL;
+    }
+    result = PyList_Append(self->pending, dst_py_obj_ptr);
+    self->pending_bytes += PyBytes_GET_SIZE(dst_py_obj_ptr);
+    Py_DECREF(dst_py_obj_ptr);
+    if (result != 0)
+    {
+        return NULL;
+    }
+
+    if (self->pending_bytes >= self->bufsize)
+    {
+        if (FrameWriter_write_pending(self) != 0)
+        {
+            /* The frame has been accepted, so a caller mustn't retry it.
+             * Only flush() reports that the data can't be written yet. */
+            if (!PyErr_ExceptionMatches(PyExc_BlockingIOError))
+            {
+                return NULL;
+            }
+            PyErr_Clear();
+        }
+    }
+    Py_RETURN_NONE;
+}
+
+
+PyDoc_STRVAR(FrameWriter_flush__doc__,
+    "flush()\n"
+    "\n"
+    "Write all pending frames.\n"
+    "\n"
+    "On a non-blocking file descriptor this may raise BlockingIOError,\n"
+    "in which case the unwritten data stays pending."
+);
+
+static PyObject *
+FrameWriter_flush(FrameWriterObject * self, PyObject * Py_UNUSED(ignored))
+{
+    if (FrameWriter_write_pending(self) != 0)
+    {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+
+static PyObject *
+FrameWriter_enter(FrameWriterObject * self, PyObject * Py_UNUSED(ignored))
+{
+    Py_INCREF(self);
+    return (PyObject *) self;
+}
+
+
+static PyObject *
+FrameWriter_exit(FrameWriterObject * self, PyObject * args)
+{
+    if (FrameWriter_write_pending(self) != 0)
+    {
+        return NULL;
+    }
+    Py_RETURN_FALSE;
+}
+
+
+PyDoc_STRVAR(FrameWriter_fileno__doc__,
+    "fileno()\n"
+    "\n"
+    "Return the file descriptor."
+);
+
+static PyObject *
+FrameWriter_fileno(FrameWriterObject * self, PyObject * Py_UNUSED(ignored))
+{
+    return PyLong_FromLong(self->fd);
+}
+
+
+static PyObject *
+FrameWriter_get_pending_bytes(FrameWriterObject * self, void * closure)
+{
+    return PyLong_FromSsize_t(self->pending_bytes);
+}
+
+
+static PyMethodDef FrameWriter_methods[] =
+{
+    { "write", (PyCFunction) FrameWriter_write, METH_O, FrameWriter_write__doc__ },
+    { "flush", (PyCFunction) FrameWriter_flush, METH_NOARGS, FrameWriter_flush__doc__ },
+    { "fileno", (PyCFunction) FrameWriter_fileno, METH_NOARGS, FrameWriter_fileno__doc__ },
+    { "__enter__", (PyCFunction) FrameWriter_enter, METH_NOARGS, NULL },
+    { "__exit__", (PyCFunction) FrameWriter_exit, METH_VARARGS, NULL },
+    { NULL, NULL, 0, NULL }
+};
+
+
+static PyGetSetDef FrameWriter_getset[] =
+{
+    { "pending_bytes", (getter) FrameWriter_get_pending_bytes, NULL, "Number of bytes not yet written.", NULL },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+
+static PyTypeObject FrameWriterType =
+{
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "cobs.framestream.FrameWriter",
+    .tp_basicsize = sizeof(FrameWriterObject),
+    .tp_dealloc = (destructor) FrameWriter_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = FrameWriter__doc__,
+    .tp_methods = FrameWriter_methods,
+    .tp_getset = FrameWriter_getset,
+    .tp_init = (initproc) FrameWriter_init,
+    .tp_new = PyType_GenericNew,
+};
+
+
+/*****************************************************************************
+ * Module definitions
+ ****************************************************************************/
+
+PyDoc_STRVAR(module__doc__,
+    "Consistent Overhead Byte Stuffing (COBS) frame streams"
+);
+
+static struct PyModuleDef moduleDef =
+{
+    PyModuleDef_HEAD_INIT,
+    "_framestream_ext",             // name of module
+    module__doc__,                  // module documentation
+    0,                              // size of per-interpreter state of the module
+    NULL,
+    NULL,
+    NULL,
+    NULL,
+    NULL
+};
+
+
+/*****************************************************************************
+ * Module initialisation
+ ****************************************************************************/
+
+PyMODINIT_FUNC
+PyInit__framestream_ext(void)
+{
+    PyObject * module;
+
+
+    if (PyType_Ready(&FrameReaderType) < 0 || PyType_Ready(&FrameWriterType) < 0)
+    {
+        return NULL;
+    }
+
+    /* Initialise framestream module C extension cobs.framestream._framestream_ext */
+    module = PyModule_Create(&moduleDef);
+    if (module == NULL)
+    {
+        return NULL;
+    }
+
+    Py_INCREF(&FrameReaderType);
+    PyModule_AddObject(module, "FrameReader", (PyObject *) &FrameReaderType);
+    Py_INCREF(&FrameWriterType);
+    PyModule_AddObject(module, "FrameWriter", (PyObject *) &FrameWriterType);
+
+    return module;
+}
@@ -0,0 +1,542 @@
+/*
+ * Reverse Consistent Overhead Byte Stuffing (rCOBS)
+ *
+ * Python C extension for rCOBS encoding and decoding functions.
+ *
+ * Copyright (c) 2010 Craig McQueen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+
+/*****************************************************************************
+ * Includes
+ ****************************************************************************/
+
+// Force Py_ssize_t to be used for s# conversions.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <string.h>
+
+
+/*****************************************************************************
+ * Defines
+ ****************************************************************************/
+
+#ifndef FALSE
+#define FALSE       (0)
+#endif
+
+#ifndef TRUE
+#define TRUE        (!FALSE)
+#endif
+
+
+#define GETSTATE(M) ((struct module_state *) PyModule_GetState(M))
+
+
+/*
+ * Given a PyObject* obj, fill in the Py_buffer* viewp with the result
+ * of PyObject_GetBuffer.  Sets and exception and issues a return NULL
+ * on any errors.
+ */
+#define GET_BUFFER_VIEW_OR_ERROUT(obj, viewp) do { \
+        if (!PyObject_CheckBuffer((obj))) { \
+            PyErr_SetString(PyExc_TypeError, \
+                            "object supporting the buffer API is required"); \
+            return NULL; \
+        } \
+        if (PyObject_GetBuffer((obj), (viewp), PyBUF_ND | PyBUF_FORMAT) == -1) { \
+            return NULL; \
+        } \
+        if (((viewp)->ndim > 1) || ((viewp)->itemsize > 1)) { \
+            PyErr_SetString(PyExc_BufferError, \
+                            "object must be a single-dimension buffer of bytes"); \
+            PyBuffer_Release((viewp)); \
+            return NULL; \
+        } \
+    } while(0);
+
+
+/* A run carried over from a previous Encoder.update() call can contribute
+ * one extra 0xFF code byte, so the bound is the same as for a full encode. */
+#define RCOBS_ENCODE_DST_BUF_LEN_MAX(SRC_LEN)           ((SRC_LEN) + ((SRC_LEN)/254u) + 1)
+#define RCOBS_DECODE_DST_BUF_LEN_MAX(SRC_LEN)           (((SRC_LEN) <= 1) ? 1 : ((SRC_LEN) - 1))
+
+
+/*****************************************************************************
+ * Types
+ ****************************************************************************/
+
+struct module_state
+{
+    /* rcobs.DecodeError exception class. */
+    PyObject * RcobsDecodeError;
+};
+
+
+typedef struct
+{
+    PyObject_HEAD
+    /* Number of non-zero bytes written since the last code byte. */
+    unsigned char   search_len;
+} RcobsEncoderObject;
+
+
+/*****************************************************************************
+ * Functions
+ ****************************************************************************/
+
+static int rcobs_traverse(PyObject *m, visitproc visit, void *arg)
+{
+    Py_VISIT(GETSTATE(m)->RcobsDecodeError);
+    return 0;
+}
+
+
+static int rcobs_clear(PyObject *m)
+{
+    Py_CLEAR(GETSTATE(m)->RcobsDecodeError);
+    return 0;
+}
+
+
+/*
+ * Encode src_len bytes from src_ptr into dst_write_ptr, continuing a run of
+ * *search_len_ptr non-zero bytes. The code (length) byte for a run is written
+ * after the run, so every byte can be emitted as soon as it is read.
+ *
+ * Returns the updated destination write pointer. The final code byte of a
+ * message is not written; that is done by the caller at the end of the message.
+ */
+static char *
+rcobs_encode_run(const char * src_ptr, Py_ssize_t src_len, char * dst_write_ptr,
+                 unsigned char * search_len_ptr)
+{
+    const char *    src_end_ptr;
+    char            src_byte;
+    unsigned char   search_len;
+
+
+    src_end_ptr = src_ptr + src_len;
+    search_len = *search_len_ptr;
+
+    while (src_ptr < src_end_ptr)
+    {
+        src_byte = *src_ptr++;
+        if (src_byte == 0)
+        {
+            /* We found a zero byte */
+            *dst_write_ptr++ = (char) (search_len + 1);
+            search_len = 0;
+        }
+        else
+        {
+            /* Copy the non-zero byte to the destination buffer */
+            *dst_write_ptr++ = src_byte;
+            search_len++;
+            if (search_len == 0xFE)
+            {
+                /* We have a long string of non-zero bytes */
+                *dst_write_ptr++ = (char) 0xFF;
+                search_len = 0;
+            }
+        }
+    }
+
+    *search_len_ptr = search_len;
+    return dst_write_ptr;
+}
+
+
+/*
+ * rcobs.encode
+ */
+PyDoc_STRVAR(rcobs_encode__doc__,
+    "Encode a string using Reverse Consistent Overhead Byte Stuffing (rCOBS).\n"
+    "\n"
+    "Input is any byte string. Output is also a byte string.\n"
+    "\n"
+    "Encoding guarantees no zero bytes in the output. The output\n"
+    "string will be expanded slightly, by a predictable amount.\n"
+    "\n"
+    "An empty string is encoded to '\\x01'."
+);
+
+/*
+ * This Python C extension function uses arguments method METH_O,
+ * meaning the arg parameter contains the single parameter
+ * to the function.
+ */
+static PyObject*
+rcobs_encode(PyObject* module, PyObject* arg)
+{
+    Py_buffer       src_py_buffer;
+    char *          dst_buf_ptr;
+    char *          dst_write_ptr;
+    unsigned char   search_len;
+    PyObject *      dst_py_obj_ptr;
+
+
+    if (PyUnicode_Check((arg)))
+    {
+        PyErr_SetString(PyExc_TypeError,
+                        "Unicode-objects must be encoded as bytes first");
+        return NULL;
+    }
+    GET_BUFFER_VIEW_OR_ERROUT(arg, &src_py_buffer);
+
+    /* Make an output string */
+    dst_py_obj_ptr = PyBytes_FromStringAndSize(NULL, RCOBS_ENCODE_DST_BUF_LEN_MAX(src_py_buffer.len));
+    if (dst_py_obj_ptr == NULL)
+    {
+        PyBuffer_Release(&src_py_buffer);
+        return NULL;
+    }
+    dst_buf_ptr = PyBytes_AsString(dst_py_obj_ptr);
+
+    /* Encode */
+    search_len = 0;
+    dst_write_ptr = rcobs_encode_run(src_py_buffer.buf, src_py_buffer.len, dst_buf_ptr, &search_len);
+
+    /* We're done with the input buffer now, so we have to release the PyBuffer. */
+    PyBuffer_Release(&src_py_buffer);
+
+    /* We've reached the end of the source data.
+     * Write the final code (length) byte, which follows the final run. */
+    *dst_write_ptr++ = (char) (search_len + 1);
+
+    /* Calculate the output length, from the value of dst_write_ptr */
+    _PyBytes_Resize(&dst_py_obj_ptr, dst_write_ptr - dst_buf_ptr);
+
+    return dst_py_obj_ptr;
+}
+
+
+/*
+ * rcobs.decode
+ */
+PyDoc_STRVAR(rcobs_decode__doc__,
+    "Decode a string using Reverse Consistent Overhead Byte Stuffing (rCOBS).\n"
+    "\n"
+    "Input should be a byte string that has been rCOBS encoded. Output\n"
+    "is also a byte string.\n"
+    "\n"
+    "A rcobs.DecodeError exception will be raised if the encoded data\n"
+    "is invalid."
+);
+
+/*
+ * This Python C extension function uses arguments method METH_O,
+ * meaning the arg parameter contains the single parameter
+ * to the function.
+ */
+static PyObject*
+rcobs_decode(PyObject* module, PyObject* arg)
+{
+    Py_buffer               src_py_buffer;
+    const char *            src_buf_ptr;
+    const char *            src_ptr;
+    Py_ssize_t              src_len;
+    char *                  dst_buf_ptr;
+    char *                  dst_end_ptr;
+    char *                  dst_write_ptr;
+    Py_ssize_t              remaining_bytes;
+    Py_ssize_t              dst_len;
+    unsigned char           len_code;
+    unsigned char           src_byte;
+    unsigned char           i;
+    int                     is_final_run;
+    PyObject *              dst_py_obj_ptr;
+
+
+    if (PyUnicode_Check((arg)))
+    {
+        PyErr_SetString(PyExc_TypeError,
+                        "Unicode-objects are not supported; byte buffer objects only");
+        return NULL;
+    }
+    GET_BUFFER_VIEW_OR_ERROUT(arg, &src_py_buffer);
+    src_buf_ptr = src_py_buffer.buf;
+    src_len = src_py_buffer.len;
+
+    /* Make an output string */
+    dst_py_obj_ptr = PyBytes_FromStringAndSize(NULL, RCOBS_DECODE_DST_BUF_LEN_MAX(src_len));
+    if (dst_py_obj_ptr == NULL)
+    {
+        PyBuffer_Release(&src_py_buffer);
+        return NULL;
+    }
+    dst_buf_ptr = PyBytes_AsString(dst_py_obj_ptr);
+
+    /* Decode, working backwards from the end of the frame. The output is
+     * written backwards from the end of the output buffer, and moved to the
+     * start of the buffer afterwards. */
+    src_ptr = src_buf_ptr + src_len;
+    dst_end_ptr = dst_buf_ptr + RCOBS_DECODE_DST_BUF_LEN_MAX(src_len);
+    dst_write_ptr = dst_end_ptr;
+    is_final_run = TRUE;
+
+    if (src_len != 0)
+    {
+        for (;;)
+        {
+            len_code = (unsigned char) *--src_ptr;
+            if (len_code == 0)
+            {
+                PyBuffer_Release(&src_py_buffer);
+                Py_DECREF(dst_py_obj_ptr);
+                PyErr_SetString(GETSTATE(module)->RcobsDecodeError, "zero byte found in input");
+                return NULL;
+            }
+            len_code--;
+
+            remaining_bytes = src_ptr - src_buf_ptr;
+            if (len_code > remaining_bytes)
+            {
+                PyBuffer_Release(&src_py_buffer);
+                Py_DECREF(dst_py_obj_ptr);
+                PyErr_SetString(GETSTATE(module)->RcobsDecodeError, "not enough input bytes for length code");
+                return NULL;
+            }
+
+            /* Add a zero after the run, except for the final run of the message */
+            if (!is_final_run && len_code != 0xFE)
+            {
+                *--dst_write_ptr = 0;
+            }
+            is_final_run = FALSE;
+
+            for (i = len_code; i != 0; i--)
+            {
+                src_byte = *--src_ptr;
+                if (src_byte == 0)
+                {
+                    PyBuffer_Release(&src_py_buffer);
+                    Py_DECREF(dst_py_obj_ptr);
+                    PyErr_SetString(GETSTATE(module)->RcobsDecodeError, "zero byte found in input");
+                    return NULL;
+                }
+                *--dst_write_ptr = src_byte;
+            }
+
+            if (src_ptr <= src_buf_ptr)
+            {
+                break;
+            }
+        }
+    }
+
+    /* We're done with the input buffer now, so we have to release the PyBuffer. */
+    PyBuffer_Release(&src_py_buffer);
+
+    /* Move the decoded data to the start of the output string */
+    dst_len = dst_end_ptr - dst_write_ptr;
+    memmove(dst_buf_ptr, dst_write_ptr, dst_len);
+    _PyBytes_Resize(&dst_py_obj_ptr, dst_len);
+
+    return dst_py_obj_ptr;
+}
+
+
+/*****************************************************************************
+ * Encoder type
+ ****************************************************************************/
+
+PyDoc_STRVAR(RcobsEncoder__doc__,
+    "Encoder()\n"
+    "\n"
+    "Incremental rCOBS encoder.\n"
+    "\n"
+    "Data passed to update() is encoded and returned immediately, without\n"
+    "waiting for the end of the run. Call finish() at the end of each\n"
+    "message to get the final code byte. The concatenation of all the\n"
+    "outputs is the same as encode() of the concatenated inputs."
+);
+
+static int
+RcobsEncoder_init(RcobsEncoderObject * self, PyObject * args, PyObject * kwds)
+{
+    static char * kwlist[] = { NULL };
+
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, ":Encoder", kwlist))
+    {
+        return -1;
+    }
+    self->search_len = 0;
+    return 0;
+}
+
+
+PyDoc_STRVAR(RcobsEncoder_update__doc__,
+    "update(data)\n"
+    "\n"
+    "Encode the next piece of a message, and return the encoded bytes."
+);
+
+static PyObject*
+RcobsEncoder_update(RcobsEncoderObject * self, PyObject * arg)
+{
+    Py_buffer       src_py_buffer;
+    char *          dst_buf_ptr;
+    char *          dst_write_ptr;
+    PyObject *      dst_py_obj_ptr;
+
+
+    if (PyUnicode_Check((arg)))
+    {
+        PyErr_SetString(PyExc_TypeError,
+                        "Unicode-objects must be encoded as bytes first");
+        return NULL;
+    }
+    GET_BUFFER_VIEW_OR_ERROUT(arg, &src_py_buffer);
+
+    /* Make an output string */
+    dst_py_obj_ptr = PyBytes_FromStringAndSize(NULL, RCOBS_ENCODE_DST_BUF_LEN_MAX(src_py_buffer.len));
+    if (dst_py_obj_ptr == NULL)
+    {
+        PyBuffer_Release(&src_py_buffer);
+        return NULL;
+    }
+    dst_buf_ptr = PyBytes_AsString(dst_py_obj_ptr);
+
+    /* Encode */
+    dst_write_ptr = rcobs_encode_run(src_py_buffer.buf, src_py_buffer.len, dst_buf_ptr, &self->search_len);
+
+    /* We're done with the input buffer now, so we have to release the PyBuffer. */
+    PyBuffer_Release(&src_py_buffer);
+
+    _PyBytes_Resize(&dst_py_obj_ptr, dst_write_ptr - dst_buf_ptr);
+
+    return dst_py_obj_ptr;
+}
+
+
+PyDoc_STRVAR(RcobsEncoder_finish__doc__,
+    "finish()\n"
+    "\n"
+    "End the current message, and return its final code byte.\n"
+    "The encoder is then ready to encode the next message."
+);
+
+static PyObject*
+RcobsEncoder_finish(RcobsEncoderObject * self, PyObject * Py_UNUSED(ignored))
+{
+    char    code_byte;
+
+
+    code_byte = (char) (self->search_len + 1);
+    self->search_len = 0;
+
+    return PyBytes_FromStringAndSize(&code_byte, 1);
+}
+
+
+static PyMethodDef RcobsEncoder_methods[] =
+{
+    { "update", (PyCFunction) RcobsEncoder_update, METH_O, RcobsEncoder_update__doc__ },
+    { "finish", (PyCFunction) RcobsEncoder_finish, METH_NOARGS, RcobsEncoder_finish__doc__ },
+    { NULL, NULL, 0, NULL }
+};
+
+
+static PyTypeObject RcobsEncoderType =
+{
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "cobs.rcobs.Encoder",
+    .tp_basicsize = sizeof(RcobsEncoderObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = RcobsEncoder__doc__,
+    .tp_methods = RcobsEncoder_methods,
+    .tp_init = (initproc) RcobsEncoder_init,
+    .tp_new = PyType_GenericNew,
+};
+
+
+/*****************************************************************************
+ * Module definitions
+ ****************************************************************************/
+
+PyDoc_STRVAR(module__doc__,
+    "Reverse Consistent Overhead Byte Stuffing (rCOBS)"
+);
+
+static PyMethodDef methodTable[] =
+{
+    { "encode", rcobs_encode, METH_O, rcobs_encode__doc__ },
+    { "decode", rcobs_decode, METH_O, rcobs_decode__doc__ },
+    { NULL, NULL, 0, NULL }
+};
+
+
+static struct PyModuleDef moduleDef =
+{
+    PyModuleDef_HEAD_INIT,
+    "_rcobs_ext",                   // name of module
+    module__doc__,                  // module documentation
+    sizeof(struct module_state),    // size of per-interpreter state of the module
+    methodTable,
+    NULL,
+    rcobs_traverse,
+    rcobs_clear,
+    NULL
+};
+
+
+/*****************************************************************************
+ * Module initialisation
+ ****************************************************************************/
+
+PyMODINIT_FUNC
+PyInit__rcobs_ext(void)
+{
+    PyObject * module;
+    struct module_state * st;
+
+
+    if (PyType_Ready(&RcobsEncoderType) < 0)
+    {
+        return NULL;
+    }
+
+    /* Initialise rcobs module C extension cobs.rcobs._rcobs_ext */
+    module = PyModule_Create(&moduleDef);
+    if (module == NULL)
+    {
+        return NULL;
+    }
+
+    st = GETSTATE(module);
+
+    /* Initialise rcobs.DecodeError exception class. */
+    st->RcobsDecodeError = PyErr_NewException("_rcobs_ext.DecodeError", NULL, NULL);
+    if (st->RcobsDecodeError == NULL)
+    {
+        Py_DECREF(module);
+        return NULL;
+    }
+    Py_INCREF(st->RcobsDecodeError);
+    PyModule_AddObject(module, "DecodeError", st->RcobsDecodeError);
+
+    Py_INCREF(&RcobsEncoderType);
+    PyModule_AddObject(module, "Encoder", (PyObject *) &RcobsEncoderType);
+
+    return module;
+}
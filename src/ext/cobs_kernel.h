@@ -0,0 +1,199 @@
+/*
+ * Consistent Overhead Byte Stuffing (COBS)
+ *
+ * COBS encoding and decoding kernels, in plain C. These are shared by the
+ * Python C extension and the cffi backend.
+ *
+ * Copyright (c) 2010 Craig McQueen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef COBS_KERNEL_H
+#define COBS_KERNEL_H
+
+
+/*****************************************************************************
+ * Includes
+ ****************************************************************************/
+
+#include <stddef.h>
+
+
+/*****************************************************************************
+ * Defines
+ ****************************************************************************/
+
+#define COBS_ENCODE_DST_BUF_LEN_MAX(SRC_LEN)            ((SRC_LEN) + ((SRC_LEN)/254u) + 1)
+#define COBS_DECODE_DST_BUF_LEN_MAX(SRC_LEN)            (((SRC_LEN) <= 1) ? 1 : ((SRC_LEN) - 1))
+
+
+/*****************************************************************************
+ * Types
+ ****************************************************************************/
+
+typedef enum
+{
+    COBS_DECODE_OK = 0,
+    COBS_DECODE_ZERO_BYTE,
+    COBS_DECODE_NOT_ENOUGH_INPUT,
+} cobs_decode_status_t;
+
+
+/*****************************************************************************
+ * Functions
+ ****************************************************************************/
+
+/*
+ * Encode src_len bytes from src_ptr into dst_buf_ptr, which must have room for
+ * COBS_ENCODE_DST_BUF_LEN_MAX(src_len) bytes.
+ *
+ * Returns the pointer to the end of the encoded data.
+ */
+static inline char *
+cobs_encode_run(const char * src_ptr, size_t src_len, char * dst_buf_ptr)
+{
+    const char *    src_end_ptr;
+    char *          dst_code_write_ptr;
+    char *          dst_write_ptr;
+    char            src_byte;
+    unsigned char   search_len;
+
+
+    src_end_ptr = src_ptr + src_len;
+
+    /* Encode */
+    dst_code_write_ptr  = dst_buf_ptr;
+    dst_write_ptr = dst_code_write_ptr + 1;
+    search_len = 1;
+
+    /* Iterate over the source bytes */
+    if (src_len != 0)
+    {
+        for (;;)
+        {
+            src_byte = *src_ptr++;
+            if (src_byte == 0)
+            {
+                /* We found a zero byte */
+                *dst_code_write_ptr = (char) search_len;
+                dst_code_write_ptr = dst_write_ptr++;
+                search_len = 1;
+                if (src_ptr >= src_end_ptr)
+                {
+                    break;
+                }
+            }
+            else
+            {
+                /* Copy the non-zero byte to the destination buffer */
+                *dst_write_ptr++ = src_byte;
+                search_len++;
+                if (src_ptr >= src_end_ptr)
+                {
+                    break;
+                }
+                if (search_len == 0xFF)
+                {
+                    /* We have a long string of non-zero bytes */
+                    *dst_code_write_ptr = (char) search_len;
+                    dst_code_write_ptr = dst_write_ptr++;
+                    search_len = 1;
+                }
+            }
+        }
+    }
+
+    /* We've reached the end of the source data.
+     * Finalise the remaining output. In particular, write the code (length) byte.
+     */
+    *dst_code_write_ptr = (char) search_len;
+
+    return dst_write_ptr;
+}
+
+
+/*
+ * Decode the COBS encoded data from src_ptr to src_end_ptr, which must be
+ * non-empty and made up of whole runs (each a code byte followed by its data
+ * bytes). Decoded data is written at *dst_write_ptr_ptr, which is updated.
+ *
+ * is_final is non-zero if the data ends at the end of the encoded message, in
+ * which case no zero byte is added after the final run.
+ */
+static inline cobs_decode_status_t
+cobs_decode_run(const char * src_ptr, const char * src_end_ptr, char ** dst_write_ptr_ptr, int is_final)
+{
+    char *                  dst_write_ptr;
+    ptrdiff_t               remaining_bytes;
+    unsigned char           len_code;
+    unsigned char           src_byte;
+    unsigned char           i;
+
+
+    dst_write_ptr = *dst_write_ptr_ptr;
+
+    for (;;)
+    {
+        len_code = (unsigned char) *src_ptr++;
+        if (len_code == 0)
+        {
+            return COBS_DECODE_ZERO_BYTE;
+        }
+        len_code--;
+
+        remaining_bytes = src_end_ptr - src_ptr;
+        if (len_code > remaining_bytes)
+        {
+            return COBS_DECODE_NOT_ENOUGH_INPUT;
+        }
+
+        for (i = len_code; i != 0; i--)
+        {
+            src_byte = *src_ptr++;
+            if (src_byte == 0)
+            {
+                return COBS_DECODE_ZERO_BYTE;
+            }
+            *dst_write_ptr++ = src_byte;
+        }
+
+        if (src_ptr >= src_end_ptr && is_final)
+        {
+            break;
+        }
+
+        /* Add a zero to the end */
+        if (len_code != 0xFE)
+        {
+            *dst_write_ptr++ = 0;
+        }
+
+        if (src_ptr >= src_end_ptr)
+        {
+            break;
+        }
+    }
+
+    *dst_write_ptr_ptr = dst_write_ptr;
+    return COBS_DECODE_OK;
+}
+
+
+#endif /* COBS_KERNEL_H */
@@ -0,0 +1,263 @@
+/*
+ * Consistent Overhead Byte Stuffing (COBS)
+ *
+ * Python C API helpers shared by the COBS and COBS/R extensions, for the
+ * encode framing options (headroom, tailroom, delimiter), encode_iov() and
+ * decode_segments(). The extensions differ only in their encoding, so the
+ * helpers are kept here to keep the two in step.
+ *
+ * Copyright (c) 2010 Craig McQueen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef COBS_PY_HELPERS_H
+#define COBS_PY_HELPERS_H
+
+
+/*****************************************************************************
+ * Includes
+ ****************************************************************************/
+
+// Force Py_ssize_t to be used for s# conversions.
+#ifndef PY_SSIZE_T_CLEAN
+#define PY_SSIZE_T_CLEAN
+#endif
+#include <Python.h>
+#include <string.h>
+
+
+/*****************************************************************************
+ * Defines
+ ****************************************************************************/
+
+#ifndef FALSE
+#define FALSE       (0)
+#endif
+
+#ifndef TRUE
+#define TRUE        (!FALSE)
+#endif
+
+
+/*****************************************************************************
+ * Functions
+ ****************************************************************************/
+
+/*
+ * Convert an optional headroom or tailroom argument, which may be None.
+ * Returns 0, or -1 with an exception set.
+ */
+static int
+cobs_py_room_arg(PyObject * room_obj, Py_ssize_t * room_ptr)
+{
+    *room_ptr = 0;
+    if (room_obj == NULL || room_obj == Py_None)
+    {
+        return 0;
+    }
+    *room_ptr = PyNumber_AsSsize_t(room_obj, PyExc_OverflowError);
+    if (*room_ptr == -1 && PyErr_Occurred())
+    {
+        return -1;
+    }
+    if (*room_ptr < 0)
+    {
+        PyErr_SetString(PyExc_ValueError, "headroom and tailroom must not be negative");
+        return -1;
+    }
+    if (*room_ptr > PY_SSIZE_T_MAX / 4)
+    {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+
+/*
+ * Parse the optional headroom, tailroom and delimiter arguments of encode,
+ * each of which may be None. Returns TRUE if any of them was given, so the
+ * output is framed, FALSE if not, or -1 with an exception set.
+ */
+static int
+cobs_py_frame_args(PyObject * headroom_obj, PyObject * tailroom_obj, PyObject * delimiter_obj,
+                   Py_ssize_t * headroom_ptr, Py_ssize_t * tailroom_ptr, int * delimiter_ptr)
+{
+    if (cobs_py_room_arg(headroom_obj, headroom_ptr) != 0 ||
+        cobs_py_room_arg(tailroom_obj, tailroom_ptr) != 0)
+    {
+        return -1;
+    }
+    *delimiter_ptr = FALSE;
+    if (delimiter_obj != NULL && delimiter_obj != Py_None)
+    {
+        *delimiter_ptr = PyObject_IsTrue(delimiter_obj);
+        if (*delimiter_ptr < 0)
+        {
+            return -1;
+        }
+    }
+    return ((headroom_obj != NULL && headroom_obj != Py_None) ||
+            (tailroom_obj != NULL && tailroom_obj != Py_None) ||
+            (delimiter_obj != NULL && delimiter_obj != Py_None)) ? TRUE : FALSE;
+}
+
+
+/*
+ * Make the output object for encode, with room for dst_len_max bytes of
+ * encoded data plus frame_room bytes. If framed, it is a bytearray, else a
+ * byte string. *dst_buf_ptr_ptr is set to the start of the output buffer.
+ */
+static PyObject *
+cobs_py_encode_output_new(int framed, Py_ssize_t dst_len_max, Py_ssize_t frame_room, char ** dst_buf_ptr_ptr)
+{
+    PyObject *      dst_py_obj_ptr;
+
+
+    if (framed)
+    {
+        dst_py_obj_ptr = PyByteArray_FromStringAndSize(NULL, dst_len_max + frame_room);
+        if (dst_py_obj_ptr != NULL)
+        {
+            *dst_buf_ptr_ptr = PyByteArray_AS_STRING(dst_py_obj_ptr);
+        }
+    }
+    else
+    {
+        dst_py_obj_ptr = PyBytes_FromStringAndSize(NULL, dst_len_max);
+        if (dst_py_obj_ptr != NULL)
+        {
+            *dst_buf_ptr_ptr = PyBytes_AsString(dst_py_obj_ptr);
+        }
+    }
+    return dst_py_obj_ptr;
+}
+
+
+/*
+ * Finish the output object for encode, given dst_len bytes of encoded data
+ * at offset headroom. The headroom, delimiter and tailroom are zero-filled,
+ * and the output is cut to length. Returns the output object, or NULL with
+ * an exception set.
+ */
+static PyObject *
+cobs_py_encode_output_finish(PyObject * dst_py_obj_ptr, int framed, Py_ssize_t dst_len,
+                             Py_ssize_t headroom, Py_ssize_t tailroom, int delimiter)
+{
+    char *          dst_buf_ptr;
+    Py_ssize_t      tail_len;
+
+
+    if (!framed)
+    {
+        _PyBytes_Resize(&dst_py_obj_ptr, dst_len);
+        return dst_py_obj_ptr;
+    }
+
+    /* The delimiter is a zero byte too, so it is filled with the tailroom. */
+    tail_len = tailroom + (delimiter ? 1 : 0);
+    dst_buf_ptr = PyByteArray_AS_STRING(dst_py_obj_ptr);
+    memset(dst_buf_ptr, 0, headroom);
+    memset(dst_buf_ptr + headroom + dst_len, 0, tail_len);
+    if (PyByteArray_Resize(dst_py_obj_ptr, headroom + dst_len + tail_len) < 0)
+    {
+        Py_DECREF(dst_py_obj_ptr);
+        return NULL;
+    }
+    return dst_py_obj_ptr;
+}
+
+
+/*
+ * Return a memoryview of the bytes of obj, with format 'B', which can be
+ * sliced to make segment views that keep obj's buffer alive.
+ */
+static PyObject *
+cobs_py_byte_memoryview(PyObject * obj, const Py_buffer * py_buffer)
+{
+    PyObject *      mv_py_obj_ptr;
+    PyObject *      cast_py_obj_ptr;
+
+
+    mv_py_obj_ptr = PyMemoryView_FromObject(obj);
+    if (mv_py_obj_ptr == NULL || py_buffer->format == NULL || strcmp(py_buffer->format, "B") == 0)
+    {
+        return mv_py_obj_ptr;
+    }
+    cast_py_obj_ptr = PyObject_CallMethod(mv_py_obj_ptr, "cast", "s", "B");
+    Py_DECREF(mv_py_obj_ptr);
+    return cast_py_obj_ptr;
+}
+
+
+/*
+ * Append the slice [start:end] of memoryview mv_py_obj_ptr to list_py_obj_ptr,
+ * unless it is empty. Returns 0, or -1 with an exception set.
+ */
+static int
+cobs_py_append_segment(PyObject * list_py_obj_ptr, PyObject * mv_py_obj_ptr, Py_ssize_t start, Py_ssize_t end)
+{
+    PyObject *      segment_py_obj_ptr;
+    int             result;
+
+
+    if (start == end)
+    {
+        return 0;
+    }
+    segment_py_obj_ptr = PySequence_GetSlice(mv_py_obj_ptr, start, end);
+    if (segment_py_obj_ptr == NULL)
+    {
+        return -1;
+    }
+    result = PyList_Append(list_py_obj_ptr, segment_py_obj_ptr);
+    Py_DECREF(segment_py_obj_ptr);
+    return result;
+}
+
+
+/*
+ * Append a byte string of num_codes length codes to list_py_obj_ptr. All
+ * but the last are 1, that is, for empty runs. Returns 0, or -1 with an
+ * exception set.
+ */
+static int
+cobs_py_append_codes(PyObject * list_py_obj_ptr, Py_ssize_t num_codes, unsigned char last_code)
+{
+    PyObject *      codes_py_obj_ptr;
+    char *          codes_ptr;
+    int             result;
+
+
+    codes_py_obj_ptr = PyBytes_FromStringAndSize(NULL, num_codes);
+    if (codes_py_obj_ptr == NULL)
+    {
+        return -1;
+    }
+    codes_ptr = PyBytes_AsString(codes_py_obj_ptr);
+    memset(codes_ptr, 1, num_codes - 1);
+    codes_ptr[num_codes - 1] = (char) last_code;
+    result = PyList_Append(list_py_obj_ptr, codes_py_obj_ptr);
+    Py_DECREF(codes_py_obj_ptr);
+    return result;
+}
+
+
+#endif /* COBS_PY_HELPERS_H */
@@ -0,0 +1,231 @@
+/*
+ * Consistent Overhead Byte Stuffing/Reduced (COBS/R)
+ *
+ * COBS/R encoding and decoding kernels, in plain C. These are shared by the
+ * Python C extension and the cffi backend.
+ *
+ * Copyright (c) 2010 Craig McQueen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+#ifndef COBSR_KERNEL_H
+#define COBSR_KERNEL_H
+
+
+/*****************************************************************************
+ * Includes
+ ****************************************************************************/
+
+#include <stddef.h>
+
+
+/*****************************************************************************
+ * Defines
+ ****************************************************************************/
+
+#define COBSR_ENCODE_DST_BUF_LEN_MAX(SRC_LEN)           ((SRC_LEN) + ((SRC_LEN)/254u) + 1)
+#define COBSR_DECODE_DST_BUF_LEN_MAX(SRC_LEN)           (((SRC_LEN) <= 1) ? 1 : (SRC_LEN))
+
+
+/*****************************************************************************
+ * Types
+ ****************************************************************************/
+
+typedef enum
+{
+    COBSR_DECODE_OK = 0,
+    COBSR_DECODE_ZERO_BYTE,
+} cobsr_decode_status_t;
+
+
+/*****************************************************************************
+ * Functions
+ ****************************************************************************/
+
+/*
+ * Encode src_len bytes from src_ptr into dst_buf_ptr, which must have room for
+ * COBSR_ENCODE_DST_BUF_LEN_MAX(src_len) bytes.
+ *
+ * Returns the pointer to the end of the encoded data.
+ */
+static inline char *
+cobsr_encode_run(const char * src_ptr, size_t src_len, char * dst_buf_ptr)
+{
+    const char *    src_end_ptr;
+    char *          dst_code_write_ptr;
+    char *          dst_write_ptr;
+    unsigned char   src_byte;
+    unsigned char   search_len;
+
+
+    src_end_ptr = src_ptr + src_len;
+
+    /* Encode */
+    dst_code_write_ptr  = dst_buf_ptr;
+    dst_write_ptr = dst_code_write_ptr + 1;
+    search_len = 1;
+    src_byte = 0;
+
+    /* Iterate over the source bytes */
+    if (src_len != 0)
+    {
+        for (;;)
+        {
+            src_byte = *src_ptr++;
+            if (src_byte == 0)
+            {
+                /* We found a zero byte */
+                *dst_code_write_ptr = (char) search_len;
+                dst_code_write_ptr = dst_write_ptr++;
+                search_len = 1;
+                if (src_ptr >= src_end_ptr)
+                {
+                    break;
+                }
+            }
+            else
+            {
+                /* Copy the non-zero byte to the destination buffer */
+                *dst_write_ptr++ = src_byte;
+                search_len++;
+                if (src_ptr >= src_end_ptr)
+                {
+                    break;
+                }
+                if (search_len == 0xFF)
+                {
+                    /* We have a long string of non-zero bytes */
+                    *dst_code_write_ptr = (char) search_len;
+                    dst_code_write_ptr = dst_write_ptr++;
+                    search_len = 1;
+                }
+            }
+        }
+    }
+
+    /* We've reached the end of the source data.
+     * Finalise the remaining output. In particular, write the code (length) byte.
+     *
+     * For COBS/R, the final code (length) byte is special: if the final data byte is
+     * greater than or equal to what would normally be the final code (length) byte,
+     * then replace the final code byte with the final data byte, and remove the final
+     * data byte from the end of the sequence. This saves one byte in the output.
+     *
+     * Update the pointer to calculate the final output length.
+     */
+    if (src_byte < search_len)
+    {
+        /* Encoding same as plain COBS */
+        *dst_code_write_ptr = (char) search_len;
+    }
+    else
+    {
+        /* Special COBS/R encoding: length code is final byte,
+         * and final byte is removed from data sequence. */
+        *dst_code_write_ptr = (char) src_byte;
+        dst_write_ptr--;
+    }
+
+    return dst_write_ptr;
+}
+
+
+/*
+ * Decode src_len bytes of COBS/R encoded data from src_ptr. Decoded data is
+ * written at *dst_write_ptr_ptr, which is updated. The destination must have
+ * room for COBSR_DECODE_DST_BUF_LEN_MAX(src_len) bytes.
+ */
+static inline cobsr_decode_status_t
+cobsr_decode_run(const char * src_ptr, size_t src_len, char ** dst_write_ptr_ptr)
+{
+    const char *            src_end_ptr;
+    char *                  dst_write_ptr;
+    ptrdiff_t               remaining_bytes;
+    unsigned char           len_code;
+    unsigned char           src_byte;
+    unsigned char           i;
+
+
+    src_end_ptr = src_ptr + src_len;
+    dst_write_ptr = *dst_write_ptr_ptr;
+
+    if (src_len != 0)
+    {
+        for (;;)
+        {
+            len_code = (unsigned char) *src_ptr++;
+            if (len_code == 0)
+            {
+                return COBSR_DECODE_ZERO_BYTE;
+            }
+
+            remaining_bytes = src_end_ptr - src_ptr;
+
+            if ((len_code - 1) < remaining_bytes)
+            {
+                for (i = len_code - 1; i != 0; i--)
+                {
+                    src_byte = *src_ptr++;
+                    if (src_byte == 0)
+                    {
+                        return COBSR_DECODE_ZERO_BYTE;
+                    }
+                    *dst_write_ptr++ = src_byte;
+                }
+
+                /* Add a zero to the end */
+                if (len_code != 0xFF)
+                {
+                    *dst_write_ptr++ = 0;
+                }
+            }
+            else
+            {
+                /* We've reached the last length code, so write the remaining
+                 * bytes and then exit the loop. */
+
+                for (i = remaining_bytes; i != 0; i--)
+                {
+                    src_byte = *src_ptr++;
+                    if (src_byte == 0)
+                    {
+                        return COBSR_DECODE_ZERO_BYTE;
+                    }
+                    *dst_write_ptr++ = src_byte;
+                }
+
+                /* Write final data byte, if applicable for COBS/R encoding. */
+                if (len_code - 1 > remaining_bytes)
+                {
+                    *dst_write_ptr++ = len_code;
+                }
+
+                /* Exit the loop */
+                break;
+            }
+        }
+    }
+
+    *dst_write_ptr_ptr = dst_write_ptr;
+    return COBSR_DECODE_OK;
+}
+
+
+#endif /* COBSR_KERNEL_H */
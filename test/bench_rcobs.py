@@ -0,0 +1,57 @@
+"""
+Benchmark rCOBS encoding and decoding against plain COBS.
+
+Run from the source tree after building the C extensions, e.g.:
+
+    python setup.py build_ext --inplace
+    PYTHONPATH=src python test/bench_rcobs.py
+"""
+
+import os
+import timeit
+
+from cobs import cobs
+from cobs import rcobs
+
+
+MESSAGE_LENGTHS = [ 16, 256, 4096, 65536, 1048576 ]
+TOTAL_BYTES = 32 * 1048576
+
+
+def bench(func, data):
+    number = max(1, TOTAL_BYTES // len(data))
+    seconds = min(timeit.repeat(lambda: func(data), number=number, repeat=3))
+    return number * len(data) / seconds / 1e6
+
+
+def bench_encoder_stream(data):
+    """rCOBS streaming: encode the message in 256-byte pieces, as a sender
+    would while the message is still being produced."""
+    def encode_stream(data):
+        encoder = rcobs.Encoder()
+        for i in range(0, len(data), 256):
+            encoder.update(data[i: i+256])
+        encoder.finish()
+    return bench(encode_stream, data)
+
+
+def main():
+    print("Extensions: cobs %s, rcobs %s" % (cobs._using_extension, rcobs._using_extension))
+    print("%10s  %12s  %12s  %12s  %12s  %12s" %
+          ("length", "cobs enc", "rcobs enc", "rcobs strm", "cobs dec", "rcobs dec"))
+    for length in MESSAGE_LENGTHS:
+        data = os.urandom(length)
+        cobs_encoded = cobs.encode(data)
+        rcobs_encoded = rcobs.encode(data)
+        print("%10d  %7.1f MB/s  %7.1f MB/s  %7.1f MB/s  %7.1f MB/s  %7.1f MB/s" % (
+            length,
+            bench(cobs.encode, data),
+            bench(rcobs.encode, data),
+            bench_encoder_stream(data),
+            bench(cobs.decode, cobs_encoded),
+            bench(rcobs.decode, rcobs_encoded),
+        ))
+
+
+if __name__ == '__main__':
+    main()
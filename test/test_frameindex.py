@@ -0,0 +1,6 @@
+
+import unittest
+
+import cobs.frameindex.test
+
+unittest.main(module=cobs.frameindex.test)
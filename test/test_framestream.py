@@ -0,0 +1,6 @@
+
+import unittest
+
+import cobs.framestream.test
+
+unittest.main(module=cobs.framestream.test)
@@ -0,0 +1,6 @@
+
+import unittest
+
+import cobs.rcobs.test
+
+unittest.main(module=cobs.rcobs.test)